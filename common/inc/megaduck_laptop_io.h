@@ -1,6 +1,8 @@
 #include <gbdk/platform.h>
 #include <stdint.h>
 
+#include <megaduck_tick.h>
+
 #ifndef _MEGADUCK_LAPTOP_IO_H
 #define _MEGADUCK_LAPTOP_IO_H
 
@@ -28,18 +30,107 @@
 //#define SYS_REPLY_MAYBE_KBD_START  0x04u  // TODO: 0x0E in megaduck disasm, but 0x04 when tested and when logged.
 #define SYS_REPLY_KBD_LEN            3u  // 2 Payload, 1 Checksum (excludes 1 length header byte)
 #define RTC_REPLY_LEN                9u  // 8 Payload, 1 Checksum (excludes 1 length header byte)
+#define SYS_REPLY_KBD_PAYLOAD_LEN    2u  // Reply payload only, as received into a buffer
+#define RTC_REPLY_PAYLOAD_LEN        8u
 
 #define RTC_SEND_LEN 8u                  // 8 Payload (excludes length header and checksum)
 
 #define MEGADUCK_KBD_BYTE_1_EXPECT   0x0Eu
 #define MEGADUCK_SIO_BOOT_OK         0x01u
 
-#define MEGADUCK_RX_MAX_PAYLOAD_LEN  14u // 13 data bytes + 1 checksum byte max reply length?
+#define MEGADUCK_RX_MAX_PAYLOAD_LEN  14u // Size of megaduck_serial_rx_buf (payload only, the checksum isn't stored)
 #define MEGADUCK_TX_MAX_PAYLOAD_LEN  14u // 13 data bytes + 1 checksum byte max reply length?
 #define TIMEOUT_2_MSEC                  2u  // Used for hardware init counter sequence
 #define TIMEOUT_100_MSEC              100u
 #define TIMEOUT_200_MSEC              200u
 
+#define SERIAL_IO_TX_TIMEOUT_TICKS      MEGADUCK_TICKS_FROM_MSEC(TIMEOUT_2_MSEC)  // A TX at the internal clock rate takes ~1 msec (8 ticks, also in megaduck_serial_io_sm83.s)
+#define SERIAL_IO_TX_TURNAROUND_TICKS   0u  // Extra gap after a TX before switching to RX, raise if a peripheral needs it
+
+// Recovery policy defaults for buffer transactions, see serial_io_policy
+#define SERIAL_IO_REPLY_TIMEOUT_MSEC   20u  // First reply byte, or the ack for a sent byte
+#define SERIAL_IO_BYTE_TIMEOUT_MSEC    10u  // Between bytes once a reply has started
+#define SERIAL_IO_DEADLINE_MSEC        40u  // Whole transaction, start to finish (a full RTC reply is ~14 msec)
+#define SERIAL_IO_BACKOFF_MSEC          8u  // Before the first retry, doubled for each one after that
+#define SERIAL_IO_RETRIES               1u  // Extra attempts after a failure
+
+// Transaction engine status, see serial_io_poll_transaction()
+#define SERIAL_IO_STATUS_IDLE    0u  // Nothing started, or the last result was already collected
+#define SERIAL_IO_STATUS_BUSY    1u  // Transaction in progress
+#define SERIAL_IO_STATUS_DONE    2u  // Finished ok, result not yet collected
+#define SERIAL_IO_STATUS_FAILED  3u  // Finished with failure, result not yet collected
+
+// Background init status, see megaduck_laptop_init_status()
+#define MEGADUCK_LAPTOP_INIT_NONE     0u  // Not started
+#define MEGADUCK_LAPTOP_INIT_PENDING  1u  // Handshake in progress
+#define MEGADUCK_LAPTOP_INIT_OK       2u  // Laptop peripheral initialized
+#define MEGADUCK_LAPTOP_INIT_FAILED   3u  // Not present or didn't answer correctly
+
+// Recovery policy for buffer transactions
+//
+// - A transaction fails as soon as it can't succeed anymore: a reply length
+//   that doesn't match the command, a bad checksum, a NAK, a missed byte
+//   (reply/byte timeout), or when it runs past its deadline
+// - Only the blocking serial_io_send_command_*() functions and the link
+//   scheduler retry, the begin/poll functions always make a single attempt
+// - Worst case time for a blocking call, which is how long it can stall a frame:
+//     (retries + 1) * (deadline + ~1 msec Abort byte) + backoff * ((1 << retries) - 1)
+//   which is 41 + 41 + 8 = 90 msec with the defaults
+// - Scheduled retries are spaced by MEGADUCK_SCHED_SPACING_MSEC instead of
+//   the backoff, and never stall the main loop
+typedef struct serial_io_policy_t {
+    uint16_t reply_timeout_ticks;
+    uint16_t byte_timeout_ticks;
+    uint16_t deadline_ticks;
+    uint16_t backoff_ticks;
+    uint8_t  retries;
+} serial_io_policy_t;
+
+// Initializer with the defaults above, shared by serial_io_policy and serial_io_policy_default
+#define SERIAL_IO_POLICY_DEFAULT_INIT { \
+    .reply_timeout_ticks = MEGADUCK_TICKS_FROM_MSEC(SERIAL_IO_REPLY_TIMEOUT_MSEC), \
+    .byte_timeout_ticks  = MEGADUCK_TICKS_FROM_MSEC(SERIAL_IO_BYTE_TIMEOUT_MSEC),  \
+    .deadline_ticks      = MEGADUCK_TICKS_FROM_MSEC(SERIAL_IO_DEADLINE_MSEC),      \
+    .backoff_ticks       = MEGADUCK_TICKS_FROM_MSEC(SERIAL_IO_BACKOFF_MSEC),       \
+    .retries             = SERIAL_IO_RETRIES,                                      \
+}
+
+extern       serial_io_policy_t serial_io_policy;
+extern const serial_io_policy_t serial_io_policy_default;
+
+
+// Link statistics, only built with MEGADUCK_LINK_STATS defined
+//
+// - Counted per command group by the transaction engine (init isn't counted),
+//   see megaduck_link_overlay.h to show them on screen
+// - Counters stop at 0xFFFF instead of wrapping
+// - Latency is from the start of a successful transaction to its end,
+//   the last histogram bin also holds everything longer
+#define MEGADUCK_LINK_STATS_KEYS      0u  // SYS_CMD_GET_KEYS
+#define MEGADUCK_LINK_STATS_RTC_GET   1u  // SYS_CMD_RTC_GET_DATE_AND_TIME
+#define MEGADUCK_LINK_STATS_RTC_SET   2u  // SYS_CMD_RTC_SET_DATE_AND_TIME
+#define MEGADUCK_LINK_STATS_OTHER     3u  // Any other command
+#define MEGADUCK_LINK_STATS_COUNT     4u
+
+#define MEGADUCK_LINK_STATS_LATENCY_BINS   8u
+#define MEGADUCK_LINK_STATS_LATENCY_SHIFT  4u  // 16 ticks (~4 msec) per bin
+
+#ifdef MEGADUCK_LINK_STATS
+typedef struct megaduck_link_stats_t {
+    uint16_t ok;
+    uint16_t timeouts;      // A byte didn't arrive in time, or the deadline passed
+    uint16_t bad_checksum;
+    uint16_t aborts;        // Reply length didn't match, or a sent byte wasn't acked
+    uint16_t retries;       // Failures that were retried (blocking calls and the link scheduler)
+    uint16_t latency[MEGADUCK_LINK_STATS_LATENCY_BINS];
+} megaduck_link_stats_t;
+
+extern megaduck_link_stats_t megaduck_link_stats[MEGADUCK_LINK_STATS_COUNT];
+
+void megaduck_link_stats_reset(void);
+void megaduck_link_stats_count_retry(uint8_t io_cmd);
+#endif
+
 
 extern uint8_t serial_cmd_0x09_reply_data;
 
@@ -52,15 +143,33 @@ extern          uint8_t megaduck_serial_rx_buf_len;
 extern          uint8_t megaduck_serial_tx_buf[MEGADUCK_TX_MAX_PAYLOAD_LEN];
 extern          uint8_t megaduck_serial_tx_buf_len;
 
+extern          uint8_t serial_io_tx_ticks_measured;
+
 
 void serial_io_wait_for_transfer_with_timeout(uint8_t);
 void serial_io_send_byte(uint8_t);
 void serial_io_enable_receive_byte(void);
 bool megaduck_laptop_controller_init(void);
 bool megaduck_laptop_init(void);
+bool megaduck_laptop_init_quick(void);
+bool    megaduck_laptop_init_begin(void);
+uint8_t megaduck_laptop_init_status(void);
 
 bool serial_io_send_command_and_buffer(uint8_t);
-bool serial_io_send_command_and_receive_buffer(uint8_t);
+bool serial_io_send_command_and_receive_buffer(uint8_t io_cmd, uint8_t * p_dest, uint8_t max_len);
+bool serial_io_send_command_and_receive_fixed(uint8_t io_cmd, uint8_t * p_dest, uint8_t payload_len);
+
+// Fixed size receives for the known replies, p_dest must hold the full payload
+#define serial_io_receive_keys(p_dest)        serial_io_send_command_and_receive_fixed(SYS_CMD_GET_KEYS, (p_dest), SYS_REPLY_KBD_PAYLOAD_LEN)
+#define serial_io_begin_receive_keys(p_dest)  serial_io_begin_command_and_receive_fixed(SYS_CMD_GET_KEYS, (p_dest), SYS_REPLY_KBD_PAYLOAD_LEN)
+#define serial_io_receive_rtc(p_dest)         serial_io_send_command_and_receive_fixed(SYS_CMD_RTC_GET_DATE_AND_TIME, (p_dest), RTC_REPLY_PAYLOAD_LEN)
+#define serial_io_begin_receive_rtc(p_dest)   serial_io_begin_command_and_receive_fixed(SYS_CMD_RTC_GET_DATE_AND_TIME, (p_dest), RTC_REPLY_PAYLOAD_LEN)
+
+bool    serial_io_begin_command_and_buffer(uint8_t);
+bool    serial_io_begin_command_and_receive_buffer(uint8_t io_cmd, uint8_t * p_dest, uint8_t max_len);
+bool    serial_io_begin_command_and_receive_fixed(uint8_t io_cmd, uint8_t * p_dest, uint8_t payload_len);
+uint8_t serial_io_poll_transaction(void);
+bool    serial_io_get_transaction_result(void);
 
 bool serial_io_read_byte_with_msecs_timeout(uint8_t);
 
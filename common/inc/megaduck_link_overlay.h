@@ -0,0 +1,31 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#ifndef _MEGADUCK_LINK_OVERLAY_H
+#define _MEGADUCK_LINK_OVERLAY_H
+
+// On screen link statistics, only built with MEGADUCK_LINK_STATS defined
+//
+// Shows megaduck_link_stats in the Window layer over the bottom of the
+// screen, two rows per command group (K: keys, G: RTC get, S: RTC set, ?: other)
+//
+//   K 0123 T00C00A00R00   ok count, then timeouts, bad checksums, aborts, retries
+//     0012000000000000    latency histogram, one byte per bin (~4 msec each)
+//
+// - Values are hex, counters above 0xFF show as FF on the first row
+// - megaduck_link_overlay_update() draws one row per call, so calling
+//   it once per frame right after vsync() stays inside VBlank
+// - Text uses the GBDK console font, where tile index == character code
+
+#define MEGADUCK_LINK_OVERLAY_ROWS   (MEGADUCK_LINK_STATS_COUNT * 2u)
+#define MEGADUCK_LINK_OVERLAY_WIDTH  20u
+
+#ifdef MEGADUCK_LINK_STATS
+void megaduck_link_overlay_show(bool show);
+void megaduck_link_overlay_update(void);
+#endif
+
+#endif // _MEGADUCK_LINK_OVERLAY_H
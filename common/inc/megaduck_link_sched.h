@@ -0,0 +1,57 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_tick.h>
+
+#ifndef _MEGADUCK_LINK_SCHED_H
+#define _MEGADUCK_LINK_SCHED_H
+
+// Serial link scheduler
+//
+// Owns the serial link once the laptop is initialized, so keyboard, RTC
+// and any other commands can share it without stepping on each other
+//
+// - Each user gets a request slot, a lower slot number is higher priority
+// - A due request that loses to a higher priority one wins the next time,
+//   so the keyboard can't starve the others
+// - Transactions start at least MEGADUCK_SCHED_SPACING_TICKS apart,
+//   polling the peripheral faster than that may lock up the keyboard
+// - Failed transactions are retried as set in serial_io_policy before
+//   the completion callback is called with the failure
+// - Call megaduck_sched_update() once per frame from the main loop
+
+#define MEGADUCK_SCHED_SLOT_KEYBOARD  0u
+#define MEGADUCK_SCHED_SLOT_RTC_SET   1u
+#define MEGADUCK_SCHED_SLOT_RTC       2u
+#define MEGADUCK_SCHED_SLOT_USER      3u
+#define MEGADUCK_SCHED_SLOT_COUNT     4u
+#define MEGADUCK_SCHED_SLOT_NONE      0xFFu
+
+// Transaction types
+#define MEGADUCK_SCHED_RECEIVE  0u  // Command then reply into megaduck_serial_rx_buf (or the slot's rx buffer)
+#define MEGADUCK_SCHED_SEND     1u  // Command then megaduck_serial_tx_buf
+
+// Period for requests that only run when triggered
+#define MEGADUCK_SCHED_ONE_SHOT 0u
+
+// Minimum time from the start of one transaction to the start of the next
+#define MEGADUCK_SCHED_SPACING_MSEC   20u
+#define MEGADUCK_SCHED_SPACING_TICKS  MEGADUCK_TICKS_FROM_MSEC(MEGADUCK_SCHED_SPACING_MSEC)
+
+// Called right before the transaction starts (ex: to fill megaduck_serial_tx_buf), may be NULL
+typedef void (*megaduck_sched_prepare_t)(void);
+// Called once the transaction has finished with its result, may be NULL
+typedef void (*megaduck_sched_complete_t)(bool ok);
+
+void megaduck_sched_init(void);
+void megaduck_sched_add(uint8_t slot, uint8_t io_cmd, uint8_t type, uint16_t period_frames,
+                        megaduck_sched_prepare_t prepare, megaduck_sched_complete_t complete);
+void megaduck_sched_set_rx_buffer(uint8_t slot, uint8_t * p_dest, uint8_t max_len);
+void megaduck_sched_remove(uint8_t slot);
+void megaduck_sched_trigger(uint8_t slot);
+void megaduck_sched_update(void);
+bool megaduck_sched_idle(void);
+uint16_t megaduck_sched_get_start_tick(void);
+
+#endif // _MEGADUCK_LINK_SCHED_H
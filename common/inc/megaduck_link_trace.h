@@ -0,0 +1,69 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef _MEGADUCK_LINK_TRACE_H
+#define _MEGADUCK_LINK_TRACE_H
+
+// Serial link trace, only recorded with MEGADUCK_LINK_TRACE defined
+//
+// The transaction engine logs every byte sent and received, timeouts and
+// the outcome of each transaction (init isn't traced) with its tick into
+// a ring buffer, so the last MEGADUCK_LINK_TRACE_LEN entries are kept
+//
+// - megaduck_link_trace_flush() copies it to cartridge SRAM (the ROM needs
+//   an MBC with RAM), host/ can replay it as the peripheral to reproduce
+//   and benchmark a field failure: make -C host replay TRACE=file.sav
+// - Entries are 4 bytes, recording one is a few stores from the serial ISR
+
+// Entry types
+#define MEGADUCK_TRACE_BEGIN    0x01u  // Transaction started, data: MEGADUCK_TRACE_TXN_*
+#define MEGADUCK_TRACE_TX       0x02u  // data: byte sent by the Duck
+#define MEGADUCK_TRACE_RX       0x03u  // data: byte received from the peripheral
+#define MEGADUCK_TRACE_TIMEOUT  0x04u  // Timeout or deadline, data: transaction phase it happened in
+#define MEGADUCK_TRACE_END      0x05u  // Transaction done, data: SERIAL_IO_STATUS_DONE / _FAILED
+
+// Transaction types for MEGADUCK_TRACE_BEGIN
+#define MEGADUCK_TRACE_TXN_RECEIVE  0u  // Command, then a reply packet from the peripheral
+#define MEGADUCK_TRACE_TXN_SEND     1u  // Command, then a buffer sent to the peripheral
+
+// Ring buffer size in entries, must be a power of 2 up to 256
+#ifndef MEGADUCK_LINK_TRACE_LEN
+    #define MEGADUCK_LINK_TRACE_LEN  128u
+#endif
+#define MEGADUCK_LINK_TRACE_MASK  (MEGADUCK_LINK_TRACE_LEN - 1u)
+
+// Where megaduck_link_trace_flush() writes in cartridge SRAM
+#ifndef MEGADUCK_LINK_TRACE_SRAM
+    #define MEGADUCK_LINK_TRACE_SRAM  ((uint8_t *)0xA000u)
+#endif
+
+// SRAM image: a header followed by header.count entries, oldest first
+// (multi-byte values are little endian)
+#define MEGADUCK_LINK_TRACE_MAGIC    "DKTR"
+#define MEGADUCK_LINK_TRACE_VERSION  1u
+
+typedef struct megaduck_link_trace_entry_t {
+    uint8_t  type;  // MEGADUCK_TRACE_*
+    uint8_t  data;
+    uint16_t tick;  // megaduck_tick_now() when it was recorded
+} megaduck_link_trace_entry_t;
+
+typedef struct megaduck_link_trace_header_t {
+    char     magic[4];    // MEGADUCK_LINK_TRACE_MAGIC, no terminator
+    uint8_t  version;     // MEGADUCK_LINK_TRACE_VERSION
+    uint8_t  entry_size;  // sizeof(megaduck_link_trace_entry_t)
+    uint16_t count;       // Entries that follow
+    uint16_t total;       // Entries recorded since the last reset (stops at 0xFFFF), older ones were overwritten
+} megaduck_link_trace_header_t;
+
+#ifdef MEGADUCK_LINK_TRACE
+extern megaduck_link_trace_entry_t megaduck_link_trace[MEGADUCK_LINK_TRACE_LEN];
+extern uint16_t megaduck_link_trace_total;
+
+void     megaduck_link_trace_reset(void);
+void     megaduck_link_trace_add(uint8_t type, uint8_t data, uint16_t tick);
+uint16_t megaduck_link_trace_flush(void);
+#endif
+
+#endif // _MEGADUCK_LINK_TRACE_H
@@ -7,6 +7,7 @@
 #define MEGADUCK_HANDHELD_STANDARD 0u
 #define MEGADUCK_LAPTOP_SPANISH    1u
 #define MEGADUCK_LAPTOP_GERMAN     2u
+#define MEGADUCK_MODEL_COUNT       3u
 
 extern uint8_t megaduck_model;
 
@@ -0,0 +1,33 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+
+#ifndef _MEGADUCK_TICK_H
+#define _MEGADUCK_TICK_H
+
+// Monotonic time base from the hardware timer (TIMA)
+//
+// - TIMA runs at 4096 Hz, so 1 tick = 256 M-cycles (~244 usec)
+// - Independent of CPU speed and compiler output, unlike counted delay loops
+#define MEGADUCK_TICK_HZ          4096u
+#define MEGADUCK_TICK_MCYCLES     256u
+
+// Converts msec to ticks, rounded up so a timeout is never shorter than requested
+// (x 4.125, close to x 4.096 using only shifts, works with runtime values too)
+#define MEGADUCK_TICKS_FROM_MSEC(ms) ((((uint16_t)(ms)) << 2) + (((uint16_t)(ms)) >> 3))
+
+// Loops that only wait for the link or the peripheral to catch up
+//
+// - The host build defines its own to leave the waiting out of its CPU time
+//   estimate (see host/inc/sim_hw.h), it's a plain while loop otherwise
+#ifndef MEGADUCK_WAIT_WHILE
+#define MEGADUCK_WAIT_WHILE(cond)  while (cond)
+#endif
+
+extern volatile uint16_t megaduck_tick_count;
+
+void     megaduck_tick_init(void);
+uint16_t megaduck_tick_now(void);
+uint16_t megaduck_tick_now_isr(void);
+void     megaduck_tick_wait(uint16_t);
+
+#endif // _MEGADUCK_TICK_H
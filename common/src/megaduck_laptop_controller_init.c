@@ -0,0 +1,65 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Does a serial IO external controller init
+//
+// - Needs to be done any time system is powered on or a cartridge is booted
+// - Sends count up sequence + some commands, waits for and checks a count down sequence in reverse
+bool megaduck_laptop_controller_init(void) {
+    uint8_t counter;
+
+    bool serial_system_init_is_ok = true;
+
+    // Send a count up sequence through the serial IO (0,1,2,3...255)
+    // Exit on 8 bit unsigned wraparound to 0x00
+    counter = 0u;
+    do {
+        serial_io_send_byte(counter++);
+    } while (counter != 0u);
+
+    // Then wait for a response
+    // Fail if reply back timed out or was not expected response
+    if (serial_io_read_byte_with_msecs_timeout(TIMEOUT_2_MSEC)) {
+        if (megaduck_serial_rx_data != SYS_REPLY_BOOT_OK) serial_system_init_is_ok = false;
+    } else
+        serial_system_init_is_ok = false;
+
+    // Send a command that seems to request a 255..0 countdown sequence from the external controller
+    if (serial_system_init_is_ok)  {
+        serial_io_send_byte(SYS_CMD_INIT_SEQ_REQUEST);
+
+        // Expects a reply sequence through the serial IO of (255,254,253...0)
+        counter = 255u;
+
+        // Exit on 8 bit unsigned wraparound to 0xFFu
+        do {
+            // Fail if reply back timed out or did not match expected counter
+            //
+            // A mismatch keeps reading like the OEM approach (the peripheral is still
+            // sending the rest of the sequence), but once it stops answering there's
+            // no point waiting out the timeout for every remaining byte
+            if (serial_io_read_byte_with_msecs_timeout(TIMEOUT_2_MSEC)) {
+                if (counter != megaduck_serial_rx_data) serial_system_init_is_ok = false;
+            } else {
+                serial_system_init_is_ok = false;
+                break;
+            }
+            counter--;
+        } while (counter != 255u);
+
+        // Check for failures during the reply sequence
+        // and send reply byte based on that
+        if (serial_system_init_is_ok)
+            serial_io_send_byte(SYS_CMD_DONE_OR_OK);
+        else
+            serial_io_send_byte(SYS_CMD_ABORT_OR_FAIL);
+    }
+
+    return serial_system_init_is_ok;
+}
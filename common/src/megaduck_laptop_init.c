@@ -0,0 +1,49 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_tick.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Initializes the laptop peripheral
+//
+// - Runs the full init handshake, which takes ~1/4 second
+//   (mostly the 256 byte count up) whether or not anything answers
+// - Only the Mega Duck has the laptop peripheral, on other
+//   targets it returns false right away without any serial traffic
+bool megaduck_laptop_init(void) {
+#ifndef __TARGET_duck
+    return false;
+#else
+    uint8_t sio_enable_saved;
+    bool laptop_init_is_ok = true;
+
+    // Only the Serial interrupt bits are touched, so VBlank, Timer
+    // and Audio handlers keep running through the ~1/4 second handshake
+    sio_enable_saved = IE_REG & SIO_IFLAG;
+    megaduck_tick_init();
+    SC_REG = 0x00u;
+    SB_REG = 0x00u;
+
+    // Initialize Serially attached peripheral
+    laptop_init_is_ok = megaduck_laptop_controller_init();
+    if (laptop_init_is_ok) {
+        // Save response from some command
+        // (so far not seen being used in 32K Bank 0)
+        serial_io_send_byte(SYS_CMD_INIT_UNKNOWN_0x09);
+        if (serial_io_read_byte_with_msecs_timeout(TIMEOUT_100_MSEC))
+            serial_cmd_0x09_reply_data = megaduck_serial_rx_data;
+    }
+
+    // Ignore the RTC init check for now
+
+    disable_interrupts();
+    IE_REG = (IE_REG & ~SIO_IFLAG) | sio_enable_saved;
+    enable_interrupts();
+
+    return (laptop_init_is_ok);
+#endif
+}
@@ -0,0 +1,61 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_tick.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+static uint8_t megaduck_laptop_init_state = MEGADUCK_LAPTOP_INIT_NONE;
+
+
+// Starts initializing the laptop peripheral in the background
+//
+// - Same handshake as megaduck_laptop_init(), but run by the serial
+//   interrupt, so VBlank and the main loop keep going (ex: loading
+//   graphics or running an intro while it finishes)
+// - Call megaduck_laptop_init_status() once per frame until it's
+//   no longer MEGADUCK_LAPTOP_INIT_PENDING, and don't start any
+//   other serial transactions until then
+// - Takes ~1/4 second, or as long as the count up if nothing answers
+// - Returns false if it couldn't be started (non Mega Duck target,
+//   or a transaction is already in progress)
+bool megaduck_laptop_init_begin(void) {
+#ifndef __TARGET_duck
+    megaduck_laptop_init_state = MEGADUCK_LAPTOP_INIT_FAILED;
+    return false;
+#else
+    if (serial_io_status == SERIAL_IO_STATUS_BUSY) return false;
+
+    megaduck_tick_init();
+    CRITICAL {
+        SC_REG = 0x00u;
+        SB_REG = 0x00u;
+    }
+
+    // Count up starts with 0x00
+    if (!serial_io_xfer_begin(0x00u, SERIAL_IO_TXN_INIT)) return false;
+
+    megaduck_laptop_init_state = MEGADUCK_LAPTOP_INIT_PENDING;
+    return true;
+#endif
+}
+
+
+// Checks on an init started with megaduck_laptop_init_begin()
+//
+// Returns one of MEGADUCK_LAPTOP_INIT_*
+uint8_t megaduck_laptop_init_status(void) {
+
+    if (megaduck_laptop_init_state == MEGADUCK_LAPTOP_INIT_PENDING) {
+
+        if (serial_io_poll_transaction() == SERIAL_IO_STATUS_BUSY)
+            return MEGADUCK_LAPTOP_INIT_PENDING;
+
+        megaduck_laptop_init_state = (serial_io_get_transaction_result()) ? MEGADUCK_LAPTOP_INIT_OK
+                                                                          : MEGADUCK_LAPTOP_INIT_FAILED;
+    }
+    return megaduck_laptop_init_state;
+}
@@ -0,0 +1,21 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#include <megaduck_model.h>
+
+
+// Same as megaduck_laptop_init(), but fails right away if the
+// startup model check didn't find a laptop
+//
+// - megaduck_laptop_check_model_vram_on_startup() must have been called first
+// - Saves the init handshake time on a handheld Duck, but a laptop is also
+//   skipped if its font wasn't found in VRAM (ex: cart not launched from the
+//   laptop System ROM menu), so use megaduck_laptop_init() when that matters
+bool megaduck_laptop_init_quick(void) {
+
+    if (megaduck_model == MEGADUCK_HANDHELD_STANDARD) return false;
+    return megaduck_laptop_init();
+}
@@ -1,13 +1,26 @@
 #include <gbdk/platform.h>
 #include <gb/isr.h>
 
-#include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
 
 #include <megaduck_laptop_io.h>
+#include <megaduck_link_trace.h>
+#include <megaduck_tick.h>
 
+#include "megaduck_laptop_io_internal.h"
+
+// Transaction engine core: the serial ISR and state machine, and
+// the state shared with the megaduck_serial_io_* / megaduck_laptop_*
+// modules (one per public function, so unused ones stay out of the ROM)
+
+#ifndef FF60_REG  // Host build provides its own
 volatile SFR __at(0xFF60) FF60_REG;
+#endif
+
+#ifndef CRITICAL_INTERRUPT  // Host build provides its own
+#define CRITICAL_INTERRUPT  CRITICAL INTERRUPT
+#endif
 
 // TODO: namespace to megaduck
 volatile bool    serial_byte_recieved;
@@ -21,329 +34,368 @@ volatile uint8_t megaduck_serial_rx_data;
 
          uint8_t serial_cmd_0x09_reply_data; // In original hardware it's requested, but used for nothing?
 
+         uint8_t serial_io_tx_ticks_measured; // How long the last serial_io_send_byte() transfer took
 
-static void delay_1_msec(void);
 
+serial_io_policy_t serial_io_policy = SERIAL_IO_POLICY_DEFAULT_INIT;
 
 
-void sio_isr(void) CRITICAL INTERRUPT {
+volatile uint8_t  serial_io_status = SERIAL_IO_STATUS_IDLE;
+volatile uint8_t  serial_io_phase  = SERIAL_IO_PHASE_NONE;
+         uint8_t  serial_io_txn_type;
+         uint16_t serial_io_timeout_ticks;
+         uint16_t serial_io_deadline_ticks;
+         uint16_t serial_io_txn_start;
+volatile uint16_t serial_io_last_activity;
 
-    // Save received data and update status flag
-    // Turn Serial ISR back off
-    megaduck_serial_rx_data = SB_REG;
-    serial_byte_recieved = true;
-    set_interrupts(IE_REG & ~SIO_IFLAG);
-}
+static   uint8_t  serial_io_txn_result;      // Status to report once the final byte is sent
+static   uint8_t  serial_io_bytes_remaining; // RX: bytes left in reply, TX: 0 once checksum is sent
+static   uint8_t  serial_io_tx_idx;
+static   uint8_t  serial_io_checksum;
+static   uint8_t * serial_io_rx_ptr;         // Where the next reply payload byte is stored
+static   uint8_t  serial_io_rx_max_len;      // Max reply payload size when the size isn't fixed
+static   uint8_t  serial_io_rx_packet_len;   // Exact length header for fixed size replies, 0 if not fixed
 
-ISR_VECTOR(VECTOR_SERIAL, sio_isr)
+#ifdef MEGADUCK_LINK_STATS
+megaduck_link_stats_t megaduck_link_stats[MEGADUCK_LINK_STATS_COUNT];
 
+         uint8_t  serial_io_fail_reason;
+static   uint8_t  serial_io_stats_idx;
+#endif
 
 
-static void delay_1_msec(void) {
-    volatile uint8_t c = 75u;
-    while (c--);
-}
+static void serial_io_xfer_step(void);
 
 
-// Waits for a serial transfer to complete with a timeout
-//
-// - Timeout length is roughly in msec (100 is about ~ 103 msec or 6.14 frames)
-// - Serial ISR populates status var if anything was received
-void serial_io_wait_for_transfer_with_timeout(uint8_t timeout_len_ms) {
-    while (timeout_len_ms--) {
-        delay_1_msec();
-        if (serial_byte_recieved)
-            return;
-    }
-}
+void sio_isr(void) CRITICAL_INTERRUPT {
 
+    megaduck_serial_rx_data = SB_REG;
 
-// Sends a byte out over serial IO
-void serial_io_send_byte(uint8_t tx_byte) {
+    // Buffer transactions are handled entirely in the ISR
+    if (serial_io_phase != SERIAL_IO_PHASE_NONE) {
+        serial_io_xfer_step();
+        return;
+    }
 
-    FF60_REG = FF60_REG_BEFORE_XFER;  // Seems optional in testing so far
-    SB_REG = tx_byte;
-    SC_REG = SIOF_XFER_START | SIOF_CLOCK_INT;
+    // Otherwise update status flag for single byte reads
+    // and turn Serial ISR back off
+    serial_byte_recieved = true;
+    IE_REG &= ~SIO_IFLAG;
+}
 
-    // TODO: the delay here seems inefficient, but need to find out actual timing on the wire first
-    delay_1_msec();
+ISR_VECTOR(VECTOR_SERIAL, sio_isr)
 
-    // Restore to SIO input and clear pending interrupt
-    IF_REG = 0x00;
-    SC_REG = SIOF_XFER_START | SIOF_CLOCK_EXT;
-}
 
+// Transaction engine
+//
+// The buffer transfers below are run by sio_isr() as a state machine so
+// that the main loop isn't stalled while a packet is in flight. Each
+// completed byte transfer (TX or RX) raises the serial interrupt, which
+// then queues up the next step of the transaction.
+//
+// - Start one with serial_io_begin_command_and_receive_buffer()
+//   or serial_io_begin_command_and_buffer()
+// - Then call serial_io_poll_transaction() (once per frame is fine)
+//   until it no longer returns SERIAL_IO_STATUS_BUSY
+// - Then collect the outcome with serial_io_get_transaction_result()
 
-// Prepares to receive data through the serial IO
+// Starts sending a byte without waiting for it to finish
 //
-// - Sets serial IO to external clock and enables ready state
-// - Turns on Serial interrupt, clears pending interrupts and turns them on
-void serial_io_enable_receive_byte(void) {
+// - Completion is signaled by the serial interrupt
+static void serial_io_xfer_start_tx(uint8_t tx_byte) {
+    SERIAL_IO_TRACE(MEGADUCK_TRACE_TX, tx_byte);
     FF60_REG = FF60_REG_BEFORE_XFER;
-    SC_REG = (SIOF_XFER_START | SIOF_CLOCK_EXT);
-    IE_REG |= SIO_IFLAG;
-    IF_REG = 0x00;
-    enable_interrupts();
+    SB_REG = tx_byte;
+    SC_REG = SIOF_XFER_START | SIOF_CLOCK_INT;
 }
 
 
-// Waits for and returns a byte from Serial IO with NO timeout
-uint8_t serial_io_read_byte_no_timeout(void) {
-    CRITICAL {
-        serial_byte_recieved = false;
-    }
-
-    serial_io_enable_receive_byte();
-    while (!serial_byte_recieved);
-    return megaduck_serial_rx_data;
+// Readies serial IO to be clocked a byte by the peripheral
+static void serial_io_xfer_arm_rx(void) {
+    FF60_REG = FF60_REG_BEFORE_XFER;
+    SC_REG = SIOF_XFER_START | SIOF_CLOCK_EXT;
 }
 
 
-// Waits for a byte from Serial IO with a timeout
-// Returns:
-// - Timeout length is roughly in msec (100 is about ~ 103 msec or 6.14 frames)
-// - If timed out: false
-// - If successful: true (rx byte will be in megaduck_serial_rx_data global)
-bool serial_io_read_byte_with_msecs_timeout(uint8_t timeout_len_ms) {
-    uint8_t msec_counter;
-    CRITICAL {
-        serial_byte_recieved = false;
-    }
-
-    serial_io_enable_receive_byte();
-
-    while (timeout_len_ms--) {
-        // Each full run of the inner loop is ~ 1msec
-        msec_counter = 75u;
-        while (msec_counter--) {
-            if (serial_byte_recieved)
-                return true;
-        }
-    }
-
-    return serial_byte_recieved;
+// Sends the final OK or Abort byte for a transaction
+//
+// - Transaction is done once it finishes sending
+// - The outcome is already decided, so the deadline no longer applies
+//   (only the byte timeout, in case the final byte gets stuck)
+void serial_io_xfer_finish(uint8_t status) {
+    serial_io_txn_result = status;
+    serial_io_deadline_ticks = 0u;
+    serial_io_phase = SERIAL_IO_PHASE_TX_FINAL;
+    serial_io_xfer_start_tx((status == SERIAL_IO_STATUS_DONE) ? SYS_CMD_DONE_OR_OK : SYS_CMD_ABORT_OR_FAIL);
 }
 
 
-// Sends a byte and waits for a reply with timeout
-// Returns:
-// - Timeout length is roughly in msec (100 is about ~ 103 msec or 6.14 frames)
-// - If timed out: false
-// - If ack/reply didn't match expected: false
-// - Otherwise true
-bool serial_io_send_byte_and_check_ack_msecs_timeout(uint8_t tx_byte, uint8_t timeout_len_ms, uint8_t expected_reply) {
-    serial_io_send_byte(tx_byte);
-
-    // Fail if first rx byte timed out
-    if (!serial_io_read_byte_with_msecs_timeout(timeout_len_ms)) return false;
-
-    // Then check reply byte vs expected reply
-    return (megaduck_serial_rx_data == expected_reply);
+#ifdef MEGADUCK_LINK_STATS
+// Returns which statistics a command is counted in
+uint8_t serial_io_stats_index(uint8_t io_cmd) {
+    switch (io_cmd) {
+        case SYS_CMD_GET_KEYS:              return MEGADUCK_LINK_STATS_KEYS;
+        case SYS_CMD_RTC_GET_DATE_AND_TIME: return MEGADUCK_LINK_STATS_RTC_GET;
+        case SYS_CMD_RTC_SET_DATE_AND_TIME: return MEGADUCK_LINK_STATS_RTC_SET;
+        default:                            return MEGADUCK_LINK_STATS_OTHER;
+    }
 }
 
 
-// Sends a command and a multi-byte buffer over Serial IO
-//
-// - Send buffer globals: megaduck_serial_tx_buf, size in: megaduck_serial_tx_buf_len
-// - Length of serial transfer: Determined by megaduck_serial_tx_buf_len
-// - Returns: true if succeeded
-//
-bool serial_io_send_command_and_buffer(uint8_t io_cmd) {
+// Counts the outcome of a finished transaction
+static void serial_io_stats_record(uint8_t status) {
 
-    // Send buffer length + 2 (for length header and checksum bytes)
-    uint8_t packet_length = megaduck_serial_tx_buf_len + 2;
-    uint8_t checksum_calc = packet_length; // Use total tx length (byte) as initial checksum
+    megaduck_link_stats_t * p_stats = &megaduck_link_stats[serial_io_stats_idx];
 
-    // Save interrupt enables and then set only Serial to ON
-    uint8_t int_enables_saved = IE_REG;
-    IE_REG = SIO_IFLAG;
+    if (status == SERIAL_IO_STATUS_DONE) {
+        // Last activity is the tick of the final byte
+        uint16_t bin = (uint16_t)(serial_io_last_activity - serial_io_txn_start) >> MEGADUCK_LINK_STATS_LATENCY_SHIFT;
+        if (bin >= MEGADUCK_LINK_STATS_LATENCY_BINS) bin = MEGADUCK_LINK_STATS_LATENCY_BINS - 1u;
 
-    // Send command to initiate buffer transfer, then check for reply
-    if (!serial_io_send_byte_and_check_ack_msecs_timeout(io_cmd, TIMEOUT_200_MSEC, SYS_REPLY_SEND_BUFFER_OK)) {
-        IE_REG = int_enables_saved;
-        return false;
+        SERIAL_IO_STATS_INC(p_stats->ok);
+        SERIAL_IO_STATS_INC(p_stats->latency[bin]);
     }
+    else if (serial_io_fail_reason == SERIAL_IO_FAIL_TIMEOUT)  SERIAL_IO_STATS_INC(p_stats->timeouts);
+    else if (serial_io_fail_reason == SERIAL_IO_FAIL_CHECKSUM) SERIAL_IO_STATS_INC(p_stats->bad_checksum);
+    else                                                       SERIAL_IO_STATS_INC(p_stats->aborts);
+}
+#endif
 
-    // Send buffer length + 2 (for length header and checksum bytes)
-    delay_1_msec;  // Delay for unknown reasons (present in system rom)
-        if (!serial_io_send_byte_and_check_ack_msecs_timeout(packet_length, TIMEOUT_200_MSEC, SYS_REPLY_SEND_BUFFER_OK)) {
-        IE_REG = int_enables_saved;
-        return false;
-    }
-
-    // Send the buffer contents
-    uint8_t buffer_bytes_to_send = megaduck_serial_tx_buf_len;
-    for (uint8_t idx = 0; idx < megaduck_serial_tx_buf_len; idx++) {
-
-        // Update checksum with next byte
-        checksum_calc += megaduck_serial_tx_buf[idx];
 
-        // Send a byte from the buffer
-        if (!serial_io_send_byte_and_check_ack_msecs_timeout(megaduck_serial_tx_buf[idx], TIMEOUT_200_MSEC, SYS_REPLY_SEND_BUFFER_OK)) {
-            IE_REG = int_enables_saved;
-            return false;
-        }
-    }
+// Ends a transaction and hands serial IO back to single byte mode
+void serial_io_xfer_end(uint8_t status) {
+    SC_REG = SIOF_XFER_START | SIOF_CLOCK_EXT;  // Restore to SIO input
+    IE_REG &= ~SIO_IFLAG;
+    serial_io_phase  = SERIAL_IO_PHASE_NONE;
+    serial_io_status = status;
+    SERIAL_IO_TRACE(MEGADUCK_TRACE_END, status);
 
-    // Done sending buffer bytes, last byte to send is checksum 
-    // Tx Checksum Byte should == (((sum of all bytes except checksum) XOR 0xFF) + 1) [two's complement]
-    checksum_calc = ~checksum_calc + 1u;  // 2's complement
-    // Note different expected reply value versus previous reply checks
-    if (!serial_io_send_byte_and_check_ack_msecs_timeout(checksum_calc, TIMEOUT_200_MSEC, SYS_REPLY_BUFFER_SEND_AND_CHECKSUM_OK)) {
-        IE_REG = int_enables_saved;
-        return false;
-    }
-
-    // Success
-    IE_REG = int_enables_saved;
-    return true;
+    #ifdef MEGADUCK_LINK_STATS
+        if (serial_io_txn_type != SERIAL_IO_TXN_INIT)
+            serial_io_stats_record(status);
+    #endif
 }
 
 
-
-// Sends a command and then receives a multi-byte buffer over Serial IO
-//
-// - Receive buffer globals: megaduck_serial_rx_buf, size in: megaduck_serial_rx_buf_len
-// - Length of serial transfer: Determined by sender
-// - Returns: true if succeeded
+// Advances the transaction state machine, called from sio_isr()
 //
-bool serial_io_send_command_and_receive_buffer(uint8_t io_cmd) {
-
-    uint8_t packet_length  = 0u;
-    uint8_t checksum_calc  = 0x00u;
-
-    // Reset global rx buffer length
-    megaduck_serial_rx_buf_len      = 0u;
-
-    // Save interrupt enables and then set only Serial to ON
-    uint8_t int_enables_saved = IE_REG;
-    IE_REG = SIO_IFLAG;
-
-    // delay_1_msec()  // Another mystery, ignore it for now
-    serial_io_send_byte(io_cmd);
-
-    // Fail if first rx byte timed out
-    if (serial_io_read_byte_with_msecs_timeout(TIMEOUT_100_MSEC)) {
-
-        // First rx byte will be length of all incoming bytes
-        if (megaduck_serial_rx_data <= MEGADUCK_RX_MAX_PAYLOAD_LEN) {
-
-            // Save rx byte as length and use to initialize checksum
-            // Reduce length by 1 (since it includes length byte already received)
-            checksum_calc = megaduck_serial_rx_data;
-            packet_length     = megaduck_serial_rx_data - 1u;
-
-            while (packet_length--) {
-                // Wait for next rx byte
-                if (serial_io_read_byte_with_msecs_timeout(TIMEOUT_100_MSEC)) {
-                    // Save rx byte to buffer and add to checksum
-                    checksum_calc                     += megaduck_serial_rx_data;
-                    megaduck_serial_rx_buf[megaduck_serial_rx_buf_len++] = megaduck_serial_rx_data;
-                } else {
-                    // Error: Break out and set checksum so it fails test below (causing return with failure)
-                    checksum_calc = 0xFFu;
+// - megaduck_serial_rx_data holds the byte from the transfer that just finished
+//   (for a TX that's whatever was shifted in and can be ignored)
+static void serial_io_xfer_step(void) {
+
+    serial_io_last_activity = megaduck_tick_now_isr();
+
+    #ifdef MEGADUCK_LINK_TRACE
+        if ((serial_io_phase == SERIAL_IO_PHASE_RX_LEN) || (serial_io_phase == SERIAL_IO_PHASE_RX_DATA) ||
+            (serial_io_phase == SERIAL_IO_PHASE_RX_ACK))
+            SERIAL_IO_TRACE(MEGADUCK_TRACE_RX, megaduck_serial_rx_data);
+    #endif
+
+    switch (serial_io_phase) {
+
+        case SERIAL_IO_PHASE_TX_CMD:
+        case SERIAL_IO_PHASE_TX_DATA:
+            // Byte sent, wait for the reply
+            serial_io_timeout_ticks = serial_io_policy.reply_timeout_ticks;
+            serial_io_phase = (serial_io_txn_type == SERIAL_IO_TXN_RECEIVE) ? SERIAL_IO_PHASE_RX_LEN : SERIAL_IO_PHASE_RX_ACK;
+            serial_io_xfer_arm_rx();
+            break;
+
+        case SERIAL_IO_PHASE_RX_LEN:
+            // First rx byte will be length of all incoming bytes (including itself and the checksum)
+            //
+            // Abort right away if the payload can't be right: fixed size replies must match
+            // exactly (one compare), others must fit in the destination buffer. A length of
+            // 0 or 1 wraps around to a huge payload size and is rejected by the size check.
+            if (serial_io_rx_packet_len) {
+                if (megaduck_serial_rx_data != serial_io_rx_packet_len) {
+                    serial_io_xfer_finish(SERIAL_IO_STATUS_FAILED);
                     break;
                 }
+            } else if ((uint8_t)(megaduck_serial_rx_data - 2u) > serial_io_rx_max_len) {
+                serial_io_xfer_finish(SERIAL_IO_STATUS_FAILED);
+                break;
             }
-
-            // Done receiving buffer bytes, last rx byte should be checksum 
+            // Save rx byte as length and use to initialize checksum
+            // Reduce length by 1 (since it includes length byte already received)
+            megaduck_serial_rx_buf_len = megaduck_serial_rx_data - 2u;
+            serial_io_checksum        = megaduck_serial_rx_data;
+            serial_io_bytes_remaining = megaduck_serial_rx_data - 1u;
+            serial_io_timeout_ticks   = serial_io_policy.byte_timeout_ticks;
+            serial_io_phase           = SERIAL_IO_PHASE_RX_DATA;
+            serial_io_xfer_arm_rx();
+            break;
+
+        case SERIAL_IO_PHASE_RX_DATA:
+            // Add rx byte to checksum, and save it unless it's the checksum itself
+            serial_io_checksum += megaduck_serial_rx_data;
+
+            if (--serial_io_bytes_remaining) {
+                *serial_io_rx_ptr++ = megaduck_serial_rx_data;
+                serial_io_xfer_arm_rx();
+                break;
+            }
+            // Done receiving buffer bytes, last rx byte should be checksum
             // Rx Checksum Byte should == (((sum of all bytes except checksum) XOR 0xFF) + 1) [two's complement]
             // so ((sum of received bytes including checksum byte) should == -> unsigned 8 bit overflow -> 0x00
-            if (checksum_calc == 0x00u) {
-                // Return success
-                serial_io_send_byte(SYS_CMD_DONE_OR_OK);
-                IE_REG = int_enables_saved;
-                return true;                
+            #ifdef MEGADUCK_LINK_STATS
+                serial_io_fail_reason = SERIAL_IO_FAIL_CHECKSUM;
+            #endif
+            serial_io_xfer_finish((serial_io_checksum == 0x00u) ? SERIAL_IO_STATUS_DONE : SERIAL_IO_STATUS_FAILED);
+            break;
+
+        case SERIAL_IO_PHASE_RX_ACK:
+            // Last byte sent is the checksum, it gets a different ack than the others
+            if (serial_io_bytes_remaining == 0u) {
+                serial_io_xfer_end((megaduck_serial_rx_data == SYS_REPLY_BUFFER_SEND_AND_CHECKSUM_OK) ? SERIAL_IO_STATUS_DONE : SERIAL_IO_STATUS_FAILED);
+                break;
+            }
+            if (megaduck_serial_rx_data != SYS_REPLY_SEND_BUFFER_OK) {
+                serial_io_xfer_end(SERIAL_IO_STATUS_FAILED);
+                break;
             }
-        }
-    }
 
-    // Something went wrong, error out
-    serial_io_send_byte(SYS_CMD_ABORT_OR_FAIL);
-    IE_REG = int_enables_saved;
-    return false;
+            // Sequence is: [cmd] -> [length] -> [buffer bytes...] -> [checksum]
+            serial_io_phase = SERIAL_IO_PHASE_TX_DATA;
+            if (serial_io_tx_idx == 0u) {
+                // Send buffer length + 2 (for length header and checksum bytes)
+                serial_io_checksum = megaduck_serial_tx_buf_len + 2u;  // Use total tx length (byte) as initial checksum
+                serial_io_xfer_start_tx(serial_io_checksum);
+            } else if (serial_io_tx_idx <= megaduck_serial_tx_buf_len) {
+                // Update checksum with next byte and send it
+                uint8_t tx_byte = megaduck_serial_tx_buf[serial_io_tx_idx - 1u];
+                serial_io_checksum += tx_byte;
+                serial_io_xfer_start_tx(tx_byte);
+            } else {
+                // Done sending buffer bytes, last byte to send is checksum
+                // Tx Checksum Byte should == (((sum of all bytes except checksum) XOR 0xFF) + 1) [two's complement]
+                serial_io_bytes_remaining = 0u;
+                serial_io_xfer_start_tx(~serial_io_checksum + 1u);  // 2's complement
+            }
+            serial_io_tx_idx++;
+            break;
+
+        case SERIAL_IO_PHASE_TX_FINAL:
+            serial_io_xfer_end(serial_io_txn_result);
+            break;
+
+        // Init handshake, same sequence as megaduck_laptop_controller_init()
+        // followed by the SYS_CMD_INIT_UNKNOWN_0x09 exchange
+        case SERIAL_IO_PHASE_INIT_COUNT_UP:
+            // Exit on 8 bit unsigned wraparound to 0x00
+            if (++serial_io_tx_idx != 0u) {
+                serial_io_xfer_start_tx(serial_io_tx_idx);
+                break;
+            }
+            serial_io_timeout_ticks = MEGADUCK_TICKS_FROM_MSEC(TIMEOUT_2_MSEC);
+            serial_io_phase         = SERIAL_IO_PHASE_INIT_BOOT_OK;
+            serial_io_xfer_arm_rx();
+            break;
+
+        case SERIAL_IO_PHASE_INIT_BOOT_OK:
+            if (megaduck_serial_rx_data != SYS_REPLY_BOOT_OK) {
+                serial_io_xfer_end(SERIAL_IO_STATUS_FAILED);
+                break;
+            }
+            serial_io_phase = SERIAL_IO_PHASE_INIT_TX_REQ;
+            serial_io_xfer_start_tx(SYS_CMD_INIT_SEQ_REQUEST);
+            break;
+
+        case SERIAL_IO_PHASE_INIT_TX_REQ:
+            serial_io_bytes_remaining = 255u;  // Next expected countdown value
+            serial_io_txn_result      = SERIAL_IO_STATUS_DONE;
+            serial_io_phase           = SERIAL_IO_PHASE_INIT_COUNTDOWN;
+            serial_io_xfer_arm_rx();
+            break;
+
+        case SERIAL_IO_PHASE_INIT_COUNTDOWN:
+            // A mismatch keeps reading the rest of the sequence, like the blocking version
+            if (megaduck_serial_rx_data != serial_io_bytes_remaining)
+                serial_io_txn_result = SERIAL_IO_STATUS_FAILED;
+
+            if (serial_io_bytes_remaining--) {
+                serial_io_xfer_arm_rx();
+                break;
+            }
+            if (serial_io_txn_result != SERIAL_IO_STATUS_DONE) {
+                serial_io_xfer_finish(SERIAL_IO_STATUS_FAILED);
+                break;
+            }
+            serial_io_phase = SERIAL_IO_PHASE_INIT_TX_ACK;
+            serial_io_xfer_start_tx(SYS_CMD_DONE_OR_OK);
+            break;
+
+        case SERIAL_IO_PHASE_INIT_TX_ACK:
+            // Initialized, the reply to this one is optional
+            serial_io_phase = SERIAL_IO_PHASE_INIT_TX_0x09;
+            serial_io_xfer_start_tx(SYS_CMD_INIT_UNKNOWN_0x09);
+            break;
+
+        case SERIAL_IO_PHASE_INIT_TX_0x09:
+            serial_io_timeout_ticks = MEGADUCK_TICKS_FROM_MSEC(TIMEOUT_100_MSEC);
+            serial_io_phase         = SERIAL_IO_PHASE_INIT_RX_0x09;
+            serial_io_xfer_arm_rx();
+            break;
+
+        case SERIAL_IO_PHASE_INIT_RX_0x09:
+            serial_cmd_0x09_reply_data = megaduck_serial_rx_data;
+            serial_io_xfer_end(SERIAL_IO_STATUS_DONE);
+            break;
+    }
 }
 
 
-// Does a serial IO external controller init
+// Shared setup for starting a transaction
 //
-// - Needs to be done any time system is powered on or a cartridge is booted
-// - Sends count up sequence + some commands, waits for and checks a count down sequence in reverse
-bool megaduck_laptop_controller_init(void) {
-    uint8_t counter;
-
-    IE_REG = SIO_IFLAG;
-    bool serial_system_init_is_ok = true;
-
-    // Send a count up sequence through the serial IO (0,1,2,3...255)
-    // Exit on 8 bit unsigned wraparound to 0x00
-    counter = 0u;
-    do {
-        serial_io_send_byte(counter++);
-    } while (counter != 0u);
-
-    // Then wait for a response
-    // Fail if reply back timed out or was not expected response
-    if (serial_io_read_byte_with_msecs_timeout(TIMEOUT_2_MSEC)) {
-        if (megaduck_serial_rx_data != SYS_REPLY_BOOT_OK) serial_system_init_is_ok = false;
-    } else
-        serial_system_init_is_ok = false;
-
-    // Send a command that seems to request a 255..0 countdown sequence from the external controller
-    if (serial_system_init_is_ok)  {
-        serial_io_send_byte(SYS_CMD_INIT_SEQ_REQUEST);
-
-        // Expects a reply sequence through the serial IO of (255,254,253...0)
-        counter = 255u;
-
-        // Exit on 8 bit unsigned wraparound to 0xFFu
-        do {
-            // Fail if reply back timed out or did not match expected counter
-            // TODO: OEM approach doesn't break out once a failure occurs, 
-            //       but maybe that's possible + sending the abort command early?
-            if (serial_io_read_byte_with_msecs_timeout(TIMEOUT_2_MSEC)) {
-                if (counter != megaduck_serial_rx_data) serial_system_init_is_ok = false;
-            } else
-                serial_system_init_is_ok = false;
-            counter--;
-        } while (counter != 255u);
-
-        // Check for failures during the reply sequence
-        // and send reply byte based on that
-        if (serial_system_init_is_ok)
-            serial_io_send_byte(SYS_CMD_DONE_OR_OK);
-        else
-            serial_io_send_byte(SYS_CMD_ABORT_OR_FAIL);
-    }
+// - The busy check and setup share one critical section, and
+//   interrupts aren't turned on separately after it
+// - Returns false if a transaction is already in progress
+bool serial_io_xfer_begin(uint8_t io_cmd, uint8_t txn_type) {
+    bool started = false;
 
-    return serial_system_init_is_ok;
-}
-
-
-bool megaduck_laptop_init(void) {
-    uint8_t int_enables_saved;
-    bool laptop_init_is_ok = true;
-`
-    disable_interrupts();
-    int_enables_saved = IE_REG;
-    SC_REG = 0x00u;
-    SB_REG = 0x00u;
-
-    // Initialize Serially attached peripheral
-    laptop_init_is_ok = megaduck_laptop_controller_init();
-    if (laptop_init_is_ok) {
-        // Save response from some command
-        // (so far not seen being used in 32K Bank 0)
-        serial_io_send_byte(SYS_CMD_INIT_UNKNOWN_0x09);
-        serial_io_read_byte_no_timeout();
-        serial_cmd_0x09_reply_data = megaduck_serial_rx_data;
+    CRITICAL {
+        if (serial_io_status != SERIAL_IO_STATUS_BUSY) {
+            serial_io_txn_type        = txn_type;
+            serial_io_tx_idx          = 0u;
+            serial_io_bytes_remaining = 0xFFu;
+            megaduck_serial_rx_buf_len = 0u;
+            if (txn_type == SERIAL_IO_TXN_INIT) {
+                // Init runs on its own per phase timeouts, the count up alone is longer than any deadline
+                serial_io_timeout_ticks  = SERIAL_IO_TX_TIMEOUT_TICKS;
+                serial_io_deadline_ticks = 0u;
+                serial_io_phase          = SERIAL_IO_PHASE_INIT_COUNT_UP;
+            } else {
+                serial_io_timeout_ticks  = serial_io_policy.reply_timeout_ticks;
+                serial_io_deadline_ticks = serial_io_policy.deadline_ticks;
+                serial_io_phase          = SERIAL_IO_PHASE_TX_CMD;
+            }
+            serial_io_last_activity   = megaduck_tick_now_isr();
+            serial_io_txn_start       = serial_io_last_activity;
+
+            #ifdef MEGADUCK_LINK_STATS
+                serial_io_stats_idx   = serial_io_stats_index(io_cmd);
+                serial_io_fail_reason = SERIAL_IO_FAIL_ABORT;
+            #endif
+            serial_io_status          = SERIAL_IO_STATUS_BUSY;
+            SERIAL_IO_TRACE(MEGADUCK_TRACE_BEGIN, txn_type);
+
+            // Only the Serial interrupt is added, others are left running
+            // so VBlank (and the main loop) can keep going during the transfer
+            IF_REG &= ~SIO_IFLAG;
+            IE_REG |= SIO_IFLAG;
+            serial_io_xfer_start_tx(io_cmd);
+            started = true;
+        }
     }
+    return started;
+}
 
-    // Ignore the RTC init check for now
-
-    IE_REG = int_enables_saved;
-    enable_interrupts();
 
-    return (laptop_init_is_ok);
+// Sets up where a reply goes and what length header it must have
+//
+// - packet_len: exact length header for a fixed size reply, or 0 for any size up to max_len
+void serial_io_rx_setup(uint8_t * p_dest, uint8_t max_len, uint8_t packet_len) {
+    serial_io_rx_ptr        = p_dest;
+    serial_io_rx_max_len    = max_len;
+    serial_io_rx_packet_len = packet_len;
 }
-
@@ -0,0 +1,87 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_link_trace.h>
+
+#ifndef _MEGADUCK_LAPTOP_IO_INTERNAL_H
+#define _MEGADUCK_LAPTOP_IO_INTERNAL_H
+
+// Shared between the megaduck_laptop_io / megaduck_serial_io_* modules only
+//
+// Each public function is in its own module so the linker only pulls in
+// what a program calls, the transaction engine (ISR and state machine)
+// in megaduck_laptop_io.c comes along with any of them that use it
+
+#ifndef FF60_REG  // Host build provides its own
+extern volatile SFR FF60_REG;
+#endif
+
+// Transaction type
+// RECEIVE and SEND match MEGADUCK_TRACE_TXN_* in link traces
+#define SERIAL_IO_TXN_RECEIVE   0u  // Send command, then receive a buffer from the peripheral
+#define SERIAL_IO_TXN_SEND      1u  // Send command, then send a buffer to the peripheral
+#define SERIAL_IO_TXN_INIT      2u  // Peripheral init handshake, see megaduck_laptop_init_begin()
+
+// Transaction phase: what the next serial interrupt means
+#define SERIAL_IO_PHASE_NONE      0u  // No transaction running, ISR uses single byte mode
+#define SERIAL_IO_PHASE_TX_CMD    1u  // Command byte being sent
+#define SERIAL_IO_PHASE_RX_LEN    2u  // Waiting for length header of reply
+#define SERIAL_IO_PHASE_RX_DATA   3u  // Waiting for reply payload / checksum bytes
+#define SERIAL_IO_PHASE_TX_DATA   4u  // Buffer byte being sent
+#define SERIAL_IO_PHASE_RX_ACK    5u  // Waiting for peripheral to ack a sent byte
+#define SERIAL_IO_PHASE_TX_FINAL  6u  // Final OK/Abort byte being sent, then done
+// Init handshake phases
+#define SERIAL_IO_PHASE_INIT_COUNT_UP   7u   // Count up byte being sent (0..255)
+#define SERIAL_IO_PHASE_INIT_BOOT_OK    8u   // Waiting for the boot ok reply
+#define SERIAL_IO_PHASE_INIT_TX_REQ     9u   // Countdown request being sent
+#define SERIAL_IO_PHASE_INIT_COUNTDOWN  10u  // Waiting for the next countdown byte (255..0)
+#define SERIAL_IO_PHASE_INIT_TX_ACK     11u  // OK for the countdown being sent
+#define SERIAL_IO_PHASE_INIT_TX_0x09    12u  // SYS_CMD_INIT_UNKNOWN_0x09 being sent
+#define SERIAL_IO_PHASE_INIT_RX_0x09    13u  // Waiting for its reply
+
+
+// Single byte mode, set by sio_isr() when a byte arrives
+extern volatile bool     serial_byte_recieved;
+
+// Transaction engine state, in megaduck_laptop_io.c
+extern volatile uint8_t  serial_io_status;
+extern volatile uint8_t  serial_io_phase;
+extern          uint8_t  serial_io_txn_type;
+extern          uint16_t serial_io_timeout_ticks;   // Max wait for the next byte of the current transaction
+extern          uint16_t serial_io_deadline_ticks;  // Max time for the whole transaction, 0 for none
+extern          uint16_t serial_io_txn_start;       // Tick the transaction started, for the deadline
+extern volatile uint16_t serial_io_last_activity;   // Tick of last completed byte, for timeouts
+
+#ifdef MEGADUCK_LINK_STATS
+// Why the current transaction failed, for the statistics
+#define SERIAL_IO_FAIL_ABORT     0u
+#define SERIAL_IO_FAIL_TIMEOUT   1u
+#define SERIAL_IO_FAIL_CHECKSUM  2u
+
+extern          uint8_t  serial_io_fail_reason;
+
+#define SERIAL_IO_STATS_INC(counter)  do { if ((counter) != 0xFFFFu) (counter)++; } while (0)
+
+uint8_t serial_io_stats_index(uint8_t io_cmd);
+#endif
+
+#ifdef MEGADUCK_LINK_TRACE
+// Records a trace entry for the current transaction (init isn't traced),
+// stamped with the tick of the last byte activity
+#define SERIAL_IO_TRACE(type, data) \
+    do { if (serial_io_txn_type != SERIAL_IO_TXN_INIT) megaduck_link_trace_add((type), (data), serial_io_last_activity); } while (0)
+#else
+#define SERIAL_IO_TRACE(type, data)
+#endif
+
+
+bool serial_io_xfer_begin(uint8_t io_cmd, uint8_t txn_type);
+void serial_io_xfer_finish(uint8_t status);
+void serial_io_xfer_end(uint8_t status);
+bool serial_io_xfer_run(uint8_t io_cmd, uint8_t txn_type);
+void serial_io_rx_setup(uint8_t * p_dest, uint8_t max_len, uint8_t packet_len);
+void serial_io_rx_setup_for_cmd(uint8_t io_cmd, uint8_t * p_dest, uint8_t max_len);
+
+#endif // _MEGADUCK_LAPTOP_IO_INTERNAL_H
@@ -0,0 +1,88 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_link_overlay.h>
+
+#ifdef MEGADUCK_LINK_STATS
+
+#define OVERLAY_WIN_MAP    ((uint8_t *)0x9C00u)
+#define OVERLAY_MAP_WIDTH  32u
+
+#define OVERLAY_TILE_FROM_CHAR(c)  ((uint8_t)(c))
+
+static const char overlay_names[MEGADUCK_LINK_STATS_COUNT] = { 'K', 'G', 'S', '?' };
+static const char overlay_hex[16] = "0123456789ABCDEF";
+
+static uint8_t overlay_row;
+
+
+// Writes a byte as two hex digit tiles
+static uint8_t * overlay_put_hex(uint8_t * p_tiles, uint8_t value) {
+    *p_tiles++ = OVERLAY_TILE_FROM_CHAR(overlay_hex[value >> 4]);
+    *p_tiles++ = OVERLAY_TILE_FROM_CHAR(overlay_hex[value & 0x0Fu]);
+    return p_tiles;
+}
+
+
+// Counters above 0xFF show as 0xFF
+static uint8_t * overlay_put_count(uint8_t * p_tiles, char label, uint16_t count) {
+    *p_tiles++ = OVERLAY_TILE_FROM_CHAR(label);
+    return overlay_put_hex(p_tiles, (count > 0xFFu) ? 0xFFu : (uint8_t)count);
+}
+
+
+// Shows or hides the statistics over the bottom of the screen
+//
+// - Draws everything once when shown, megaduck_link_overlay_update() keeps it current
+void megaduck_link_overlay_show(bool show) {
+
+    if (show) {
+        overlay_row = 0u;
+        for (uint8_t row = 0u; row < MEGADUCK_LINK_OVERLAY_ROWS; row++)
+            megaduck_link_overlay_update();
+
+        WX_REG = DEVICE_WINDOW_PX_OFFSET_X;
+        WY_REG = DEVICE_SCREEN_PX_HEIGHT - (MEGADUCK_LINK_OVERLAY_ROWS * 8u);
+        LCDC_REG |= LCDCF_WIN9C00;
+        SHOW_WIN;
+    } else
+        HIDE_WIN;
+}
+
+
+// Redraws the next row of the statistics
+void megaduck_link_overlay_update(void) {
+
+    uint8_t tiles[MEGADUCK_LINK_OVERLAY_WIDTH];
+    uint8_t * p_tiles = tiles;
+    uint8_t * p_map   = OVERLAY_WIN_MAP + (overlay_row * OVERLAY_MAP_WIDTH);
+    const megaduck_link_stats_t * p_stats = &megaduck_link_stats[overlay_row >> 1];
+
+    if ((overlay_row & 0x01u) == 0u) {
+        *p_tiles++ = OVERLAY_TILE_FROM_CHAR(overlay_names[overlay_row >> 1]);
+        *p_tiles++ = OVERLAY_TILE_FROM_CHAR(' ');
+        p_tiles = overlay_put_hex(p_tiles, (uint8_t)(p_stats->ok >> 8));
+        p_tiles = overlay_put_hex(p_tiles, (uint8_t)p_stats->ok);
+        *p_tiles++ = OVERLAY_TILE_FROM_CHAR(' ');
+        p_tiles = overlay_put_count(p_tiles, 'T', p_stats->timeouts);
+        p_tiles = overlay_put_count(p_tiles, 'C', p_stats->bad_checksum);
+        p_tiles = overlay_put_count(p_tiles, 'A', p_stats->aborts);
+        p_tiles = overlay_put_count(p_tiles, 'R', p_stats->retries);
+    } else {
+        *p_tiles++ = OVERLAY_TILE_FROM_CHAR(' ');
+        *p_tiles++ = OVERLAY_TILE_FROM_CHAR(' ');
+        for (uint8_t bin = 0u; bin < MEGADUCK_LINK_STATS_LATENCY_BINS; bin++)
+            p_tiles = overlay_put_hex(p_tiles, (p_stats->latency[bin] > 0xFFu) ? 0xFFu : (uint8_t)p_stats->latency[bin]);
+    }
+    while (p_tiles != &tiles[MEGADUCK_LINK_OVERLAY_WIDTH])
+        *p_tiles++ = OVERLAY_TILE_FROM_CHAR(' ');
+
+    for (uint8_t c = 0u; c < MEGADUCK_LINK_OVERLAY_WIDTH; c++)
+        set_vram_byte(p_map++, tiles[c]);
+
+    if (++overlay_row == MEGADUCK_LINK_OVERLAY_ROWS) overlay_row = 0u;
+}
+
+#endif // MEGADUCK_LINK_STATS
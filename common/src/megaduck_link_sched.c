@@ -0,0 +1,206 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_tick.h>
+#include <megaduck_link_sched.h>
+
+
+#define SCHED_FLAG_ACTIVE    0x01u  // Slot is in use
+#define SCHED_FLAG_PENDING   0x02u  // Run as soon as possible (one-shot trigger, or first periodic run)
+#define SCHED_FLAG_DEFERRED  0x04u  // Was due but lost to a higher priority slot
+
+typedef struct megaduck_sched_slot_t {
+    megaduck_sched_prepare_t  prepare;
+    megaduck_sched_complete_t complete;
+    uint8_t * p_rx_dest;  // Reply destination for MEGADUCK_SCHED_RECEIVE
+    uint16_t period;      // In frames, MEGADUCK_SCHED_ONE_SHOT if only run when triggered
+    uint16_t last_start;  // sys_time when it last started
+    uint8_t  io_cmd;
+    uint8_t  type;
+    uint8_t  flags;
+    uint8_t  rx_max_len;
+    uint8_t  retries;     // Failed attempts so far for the current request
+} megaduck_sched_slot_t;
+
+static megaduck_sched_slot_t sched_slots[MEGADUCK_SCHED_SLOT_COUNT];
+static uint8_t  sched_active_slot = MEGADUCK_SCHED_SLOT_NONE;
+static uint16_t sched_last_start_tick;
+
+
+// Clears all requests
+//
+// - Call after megaduck_laptop_init() (which starts the tick time base)
+void megaduck_sched_init(void) {
+
+    for (uint8_t slot = 0u; slot < MEGADUCK_SCHED_SLOT_COUNT; slot++)
+        sched_slots[slot].flags = 0x00u;
+
+    sched_active_slot     = MEGADUCK_SCHED_SLOT_NONE;
+    sched_last_start_tick = megaduck_tick_now() - MEGADUCK_SCHED_SPACING_TICKS;
+}
+
+
+// Sets up the request for a slot
+//
+// - period_frames: how often to run it, or MEGADUCK_SCHED_ONE_SHOT to only
+//   run it when triggered with megaduck_sched_trigger()
+// - Periodic requests run for the first time as soon as possible
+// - Replies go into megaduck_serial_rx_buf unless megaduck_sched_set_rx_buffer() is used
+void megaduck_sched_add(uint8_t slot, uint8_t io_cmd, uint8_t type, uint16_t period_frames,
+                        megaduck_sched_prepare_t prepare, megaduck_sched_complete_t complete) {
+
+    megaduck_sched_slot_t * p_slot = &sched_slots[slot];
+
+    p_slot->prepare    = prepare;
+    p_slot->complete   = complete;
+    p_slot->p_rx_dest  = megaduck_serial_rx_buf;
+    p_slot->rx_max_len = MEGADUCK_RX_MAX_PAYLOAD_LEN;
+    p_slot->period     = period_frames;
+    p_slot->io_cmd     = io_cmd;
+    p_slot->type       = type;
+    p_slot->retries    = 0u;
+    p_slot->flags      = (period_frames == MEGADUCK_SCHED_ONE_SHOT) ? SCHED_FLAG_ACTIVE
+                                                                    : (SCHED_FLAG_ACTIVE | SCHED_FLAG_PENDING);
+}
+
+
+// Makes a receive slot store its reply payload straight into p_dest
+//
+// - Replies larger than max_len fail the transaction
+// - p_dest is written while the transaction runs, only read it
+//   from the completion callback (or after it was called)
+void megaduck_sched_set_rx_buffer(uint8_t slot, uint8_t * p_dest, uint8_t max_len) {
+
+    sched_slots[slot].p_rx_dest  = p_dest;
+    sched_slots[slot].rx_max_len = max_len;
+}
+
+
+// Stops a slot from being scheduled
+//
+// - If its transaction is in progress it still finishes,
+//   but the completion callback is not called
+void megaduck_sched_remove(uint8_t slot) {
+    sched_slots[slot].flags = 0x00u;
+}
+
+
+// Requests a slot to run as soon as possible
+void megaduck_sched_trigger(uint8_t slot) {
+
+    if (sched_slots[slot].flags & SCHED_FLAG_ACTIVE)
+        sched_slots[slot].flags |= SCHED_FLAG_PENDING;
+}
+
+
+// Returns true if no transaction is in progress or waiting to be collected
+bool megaduck_sched_idle(void) {
+    return (sched_active_slot == MEGADUCK_SCHED_SLOT_NONE);
+}
+
+
+// Returns the tick when the most recent transaction started
+//
+// - While a completion callback runs, that's the start of its own transaction
+uint16_t megaduck_sched_get_start_tick(void) {
+    return sched_last_start_tick;
+}
+
+
+static bool megaduck_sched_due(const megaduck_sched_slot_t * p_slot) {
+
+    if (!(p_slot->flags & SCHED_FLAG_ACTIVE)) return false;
+    if (p_slot->flags & SCHED_FLAG_PENDING)   return true;
+
+    return ((p_slot->period != MEGADUCK_SCHED_ONE_SHOT) &&
+            ((uint16_t)(sys_time - p_slot->last_start) >= p_slot->period));
+}
+
+
+// Picks the next slot to run
+//
+// - Highest priority due slot, unless a lower priority one was already passed over
+static uint8_t megaduck_sched_pick(void) {
+
+    uint8_t pick = MEGADUCK_SCHED_SLOT_NONE;
+
+    for (uint8_t slot = 0u; slot < MEGADUCK_SCHED_SLOT_COUNT; slot++) {
+        if (megaduck_sched_due(&sched_slots[slot])) {
+            if ((pick == MEGADUCK_SCHED_SLOT_NONE) ||
+                ((sched_slots[slot].flags & SCHED_FLAG_DEFERRED) && !(sched_slots[pick].flags & SCHED_FLAG_DEFERRED)))
+                pick = slot;
+        }
+    }
+
+    // Everything else that was due has now waited a turn
+    if (pick != MEGADUCK_SCHED_SLOT_NONE) {
+        for (uint8_t slot = 0u; slot < MEGADUCK_SCHED_SLOT_COUNT; slot++) {
+            if ((slot != pick) && megaduck_sched_due(&sched_slots[slot]))
+                sched_slots[slot].flags |= SCHED_FLAG_DEFERRED;
+        }
+    }
+    return pick;
+}
+
+
+// Collects the finished transaction (if any) and starts the next due one
+//
+// - Completion callbacks are called from here, not from the interrupt
+void megaduck_sched_update(void) {
+
+    megaduck_sched_slot_t * p_slot;
+    uint8_t pick;
+    bool    ok;
+
+    if (sched_active_slot != MEGADUCK_SCHED_SLOT_NONE) {
+
+        if (serial_io_poll_transaction() == SERIAL_IO_STATUS_BUSY) return;
+
+        p_slot = &sched_slots[sched_active_slot];
+        sched_active_slot = MEGADUCK_SCHED_SLOT_NONE;
+
+        // Result must always be collected to free up the engine
+        ok = serial_io_get_transaction_result();
+        if (p_slot->flags & SCHED_FLAG_ACTIVE) {
+
+            // A failure is retried up to serial_io_policy.retries times before
+            // the callback hears about it, the transaction spacing is the backoff
+            if (!ok && (p_slot->retries < serial_io_policy.retries)) {
+                p_slot->retries++;
+                p_slot->flags |= SCHED_FLAG_PENDING;
+
+                #ifdef MEGADUCK_LINK_STATS
+                    megaduck_link_stats_count_retry(p_slot->io_cmd);
+                #endif
+            } else {
+                p_slot->retries = 0u;
+                if (p_slot->complete)
+                    p_slot->complete(ok);
+            }
+        }
+    }
+
+    if ((uint16_t)(megaduck_tick_now() - sched_last_start_tick) < MEGADUCK_SCHED_SPACING_TICKS) return;
+
+    pick = megaduck_sched_pick();
+    if (pick == MEGADUCK_SCHED_SLOT_NONE) return;
+
+    p_slot = &sched_slots[pick];
+    if (p_slot->prepare)
+        p_slot->prepare();
+
+    if (p_slot->type == MEGADUCK_SCHED_SEND)
+        ok = serial_io_begin_command_and_buffer(p_slot->io_cmd);
+    else
+        ok = serial_io_begin_command_and_receive_buffer(p_slot->io_cmd, p_slot->p_rx_dest, p_slot->rx_max_len);
+
+    // If the link was busy with a direct (non-scheduled) transaction the slot stays due
+    if (ok) {
+        p_slot->flags &= ~(SCHED_FLAG_PENDING | SCHED_FLAG_DEFERRED);
+        p_slot->last_start    = sys_time;
+        sched_active_slot     = pick;
+        sched_last_start_tick = megaduck_tick_now();
+    }
+}
@@ -0,0 +1,18 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <string.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+#ifdef MEGADUCK_LINK_STATS
+// Clears all link statistics
+void megaduck_link_stats_reset(void) {
+    CRITICAL {
+        memset(megaduck_link_stats, 0x00u, sizeof(megaduck_link_stats));
+    }
+}
+#endif
@@ -0,0 +1,15 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+#ifdef MEGADUCK_LINK_STATS
+// Counts a failed transaction that's about to be retried
+void megaduck_link_stats_count_retry(uint8_t io_cmd) {
+    SERIAL_IO_STATS_INC(megaduck_link_stats[serial_io_stats_index(io_cmd)].retries);
+}
+#endif
@@ -0,0 +1,83 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <megaduck_link_trace.h>
+
+#ifdef MEGADUCK_LINK_TRACE
+
+#if (MEGADUCK_LINK_TRACE_LEN > 256u) || (MEGADUCK_LINK_TRACE_LEN & MEGADUCK_LINK_TRACE_MASK)
+    #error "MEGADUCK_LINK_TRACE_LEN must be a power of 2 up to 256"
+#endif
+
+megaduck_link_trace_entry_t megaduck_link_trace[MEGADUCK_LINK_TRACE_LEN];
+uint16_t megaduck_link_trace_total;
+
+static volatile uint8_t trace_head;    // Next entry to write
+static volatile bool trace_frozen;     // Set while flushing, new entries are dropped
+
+
+// Clears the trace
+void megaduck_link_trace_reset(void) {
+    CRITICAL {
+        trace_head                = 0u;
+        megaduck_link_trace_total = 0u;
+    }
+}
+
+
+// Records an entry, overwriting the oldest once the ring is full
+//
+// - Called by the transaction engine, mostly from the serial ISR
+void megaduck_link_trace_add(uint8_t type, uint8_t data, uint16_t tick) {
+
+    if (trace_frozen) return;
+
+    megaduck_link_trace_entry_t * p_entry = &megaduck_link_trace[trace_head & MEGADUCK_LINK_TRACE_MASK];
+    p_entry->type = type;
+    p_entry->data = data;
+    p_entry->tick = tick;
+    trace_head++;
+
+    if (megaduck_link_trace_total != 0xFFFFu) megaduck_link_trace_total++;
+}
+
+
+// Copies the trace to cartridge SRAM at MEGADUCK_LINK_TRACE_SRAM, oldest entry first
+//
+// - Recording pauses during the copy instead of disabling interrupts,
+//   so a transaction in flight keeps running (its entries are lost)
+// - Returns the number of bytes written
+uint16_t megaduck_link_trace_flush(void) {
+
+    megaduck_link_trace_header_t header;
+    uint8_t * p_sram = MEGADUCK_LINK_TRACE_SRAM;
+    uint8_t   idx;
+
+    trace_frozen = true;
+
+    memcpy(header.magic, MEGADUCK_LINK_TRACE_MAGIC, sizeof(header.magic));
+    header.version    = MEGADUCK_LINK_TRACE_VERSION;
+    header.entry_size = sizeof(megaduck_link_trace_entry_t);
+    header.total      = megaduck_link_trace_total;
+    header.count      = (header.total < MEGADUCK_LINK_TRACE_LEN) ? header.total : MEGADUCK_LINK_TRACE_LEN;
+
+    // Oldest entry is at the head once the ring has wrapped
+    idx = (header.count < MEGADUCK_LINK_TRACE_LEN) ? 0u : trace_head;
+
+    ENABLE_RAM;
+    memcpy(p_sram, &header, sizeof(header));
+    p_sram += sizeof(header);
+    for (uint16_t c = 0u; c < header.count; c++) {
+        memcpy(p_sram, &megaduck_link_trace[idx & MEGADUCK_LINK_TRACE_MASK], sizeof(megaduck_link_trace_entry_t));
+        p_sram += sizeof(megaduck_link_trace_entry_t);
+        idx++;
+    }
+    DISABLE_RAM;
+
+    trace_frozen = false;
+    return sizeof(header) + (header.count * sizeof(megaduck_link_trace_entry_t));
+}
+
+#endif // MEGADUCK_LINK_TRACE
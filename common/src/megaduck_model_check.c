@@ -0,0 +1,91 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <megaduck_model.h>
+
+
+#ifndef MEGADUCK_VRAM_READ  // Host build provides its own
+    // Unchecked VRAM read, only valid while VRAM is accessible
+    #define MEGADUCK_VRAM_READ(p_dest, p_vram, len) memcpy((p_dest), (p_vram), (len))
+#endif
+
+#define MEGADUCK_MODEL_TILE_ADDR_CHECK 0x8D00u  // First tile at 0x8D00, Second tile at 0x8D10
+#define MEGADUCK_MODEL_SIG_LEN         32u      // 2 consecutive tiles
+
+#define LY_VBLANK_START  144u
+
+// Signatures of the 2 consecutive font tiles at MEGADUCK_MODEL_TILE_ADDR_CHECK
+//
+// * Spanish model: Upside-down black Question Mark and Exclamation Point
+// * German  model: 2 pixel tall black Underscore and Inverted 0 on dark grey background
+//
+// Each is a hash of the tile bytes plus one byte checked directly to rule
+// out collisions. To add a model get its tile bytes from VRAM and run
+// tools/megaduck_model_sig.py on them, then add the printed line here
+typedef struct megaduck_model_sig_t {
+    uint16_t hash;       // See megaduck_model_hash()
+    uint8_t  check_idx;  // Tile byte that must also match
+    uint8_t  check_val;
+    uint8_t  model;
+} megaduck_model_sig_t;
+
+static const megaduck_model_sig_t model_sigs[] = {
+    { 0xE8C0u,  2u, 0x18u, MEGADUCK_LAPTOP_SPANISH },
+    { 0xF6E4u, 19u, 0xC3u, MEGADUCK_LAPTOP_GERMAN  },
+};
+
+#define MODEL_SIGS_COUNT (sizeof(model_sigs) / sizeof(model_sigs[0]))
+
+
+// Fletcher style 16 bit hash, two 8 bit running sums (cheap on the SM83)
+static uint16_t megaduck_model_hash(const uint8_t * p_buf, uint8_t len) {
+
+    uint8_t sum_lo = 0u;
+    uint8_t sum_hi = 0u;
+
+    while (len--) {
+        sum_lo += *p_buf++;
+        sum_hi += sum_lo;
+    }
+    return ((uint16_t)sum_hi << 8) | sum_lo;
+}
+
+
+// This detection only works immediately after a program is
+// launched from the cart slot from the MegaDuck laptop System ROM
+// main menu. It works by checking the difference in Font VRAM Tile Patterns
+// (which aren't cleared before cart launch) between the Spanish and German
+// models, which have slightly different character sets.
+//
+// The tiles are copied out of VRAM once, all in the same VBlank,
+// so the cost doesn't grow with the number of models to check
+//
+// Disclaimer: It has not been widely tested due to limited hardware availability
+void megaduck_laptop_check_model_vram_on_startup(void) {
+
+    uint8_t  tiles[MEGADUCK_MODEL_SIG_LEN];
+    uint16_t hash;
+
+    megaduck_model = MEGADUCK_HANDHELD_STANDARD; // Default
+
+    // Wait for the start of VBlank (polled, so it works with interrupts off too),
+    // which leaves plenty of time to copy the tiles
+    if (LCDC_REG & LCDCF_ON) {
+        while (LY_REG == LY_VBLANK_START);
+        while (LY_REG != LY_VBLANK_START);
+    }
+    CRITICAL {
+        MEGADUCK_VRAM_READ(tiles, (uint8_t *)MEGADUCK_MODEL_TILE_ADDR_CHECK, MEGADUCK_MODEL_SIG_LEN);
+    }
+
+    hash = megaduck_model_hash(tiles, MEGADUCK_MODEL_SIG_LEN);
+
+    for (uint8_t c = 0u; c < MODEL_SIGS_COUNT; c++) {
+        if ((model_sigs[c].hash == hash) && (tiles[model_sigs[c].check_idx] == model_sigs[c].check_val)) {
+            megaduck_model = model_sigs[c].model;
+            return;
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Starts sending a command and then receiving a multi-byte buffer over Serial IO
+//
+// - Reply payload goes straight into p_dest (checksum is not stored),
+//   size in: megaduck_serial_rx_buf_len
+// - Replies with more than max_len payload bytes, or a size other than the
+//   command's known reply size, fail without touching p_dest
+// - p_dest should not be used until the transaction is finished,
+//   its contents are undefined if it failed
+// - For the known replies serial_io_begin_receive_keys() / _rtc() skip the command lookup
+// - Returns: false if a transaction is already in progress
+bool serial_io_begin_command_and_receive_buffer(uint8_t io_cmd, uint8_t * p_dest, uint8_t max_len) {
+
+    if (serial_io_status == SERIAL_IO_STATUS_BUSY) return false;
+
+    serial_io_rx_setup_for_cmd(io_cmd, p_dest, max_len);
+    return serial_io_xfer_begin(io_cmd, SERIAL_IO_TXN_RECEIVE);
+}
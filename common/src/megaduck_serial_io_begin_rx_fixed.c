@@ -0,0 +1,23 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Starts sending a command and then receiving a reply of exactly payload_len bytes
+//
+// - Same as serial_io_begin_command_and_receive_buffer(), for replies with a size
+//   known at compile time (see the serial_io_*_receive_keys / _rtc() macros)
+// - Any other reply size fails at its length header, so once it succeeds
+//   p_dest holds exactly payload_len bytes and there's nothing to re-check
+// - Returns: false if a transaction is already in progress
+bool serial_io_begin_command_and_receive_fixed(uint8_t io_cmd, uint8_t * p_dest, uint8_t payload_len) {
+
+    if (serial_io_status == SERIAL_IO_STATUS_BUSY) return false;
+
+    serial_io_rx_setup(p_dest, payload_len, payload_len + 2u);
+    return serial_io_xfer_begin(io_cmd, SERIAL_IO_TXN_RECEIVE);
+}
@@ -0,0 +1,17 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Starts sending a command and a multi-byte buffer over Serial IO
+//
+// - Send buffer globals: megaduck_serial_tx_buf, size in: megaduck_serial_tx_buf_len
+//   (should not be modified until the transaction is finished)
+// - Returns: false if a transaction is already in progress
+bool serial_io_begin_command_and_buffer(uint8_t io_cmd) {
+    return serial_io_xfer_begin(io_cmd, SERIAL_IO_TXN_SEND);
+}
@@ -0,0 +1,22 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Prepares to receive data through the serial IO
+//
+// - Sets serial IO to external clock and enables ready state
+// - Turns on Serial interrupt, clears a pending Serial interrupt and turns interrupts on
+// - Other interrupt enables and pending flags are left as they are
+void serial_io_enable_receive_byte(void) {
+    FF60_REG = FF60_REG_BEFORE_XFER;
+    SC_REG = (SIOF_XFER_START | SIOF_CLOCK_EXT);
+    disable_interrupts();
+    IF_REG &= ~SIO_IFLAG;
+    IE_REG |= SIO_IFLAG;
+    enable_interrupts();
+}
@@ -0,0 +1,9 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+
+// Recovery policy defaults, ex: serial_io_policy = serial_io_policy_default;
+const serial_io_policy_t serial_io_policy_default = SERIAL_IO_POLICY_DEFAULT_INIT;
@@ -0,0 +1,57 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_tick.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Checks on a transaction in progress and handles timeouts
+//
+// - Timeouts are measured per byte with the tick time base (see serial_io_policy),
+//   and running past the transaction deadline is handled the same way
+// - Returns: one of SERIAL_IO_STATUS_*
+uint8_t serial_io_poll_transaction(void) {
+
+    CRITICAL {
+        uint16_t now = megaduck_tick_now_isr();
+
+        if ((serial_io_status == SERIAL_IO_STATUS_BUSY) &&
+            (((uint16_t)(now - serial_io_last_activity) >= serial_io_timeout_ticks) ||
+             ((serial_io_deadline_ticks != 0u) && ((uint16_t)(now - serial_io_txn_start) >= serial_io_deadline_ticks)))) {
+
+            // Stop listening before giving up. A byte that still finished by
+            // then isn't a timeout: sio_isr() takes it once the critical section
+            // ends (and would take its pending interrupt as the end of the Abort
+            // byte otherwise, with the Abort byte itself overwritten in SB)
+            SC_REG = SIOF_CLOCK_EXT;
+            if (!(IF_REG & SIO_IFLAG)) {
+
+                // The Abort byte still gets a full timeout to go out
+                serial_io_last_activity  = now;
+                serial_io_deadline_ticks = 0u;
+                SERIAL_IO_TRACE(MEGADUCK_TRACE_TIMEOUT, serial_io_phase);
+
+                #ifdef MEGADUCK_LINK_STATS
+                    if (serial_io_phase != SERIAL_IO_PHASE_TX_FINAL)
+                        serial_io_fail_reason = SERIAL_IO_FAIL_TIMEOUT;
+                #endif
+
+                // Receiving sends an abort to the peripheral (unless that's what got stuck),
+                // Sending just gives up on it
+                //
+                // Init aborts if the countdown stops, and is still ok if only the 0x09 reply is missing
+                if (serial_io_phase == SERIAL_IO_PHASE_INIT_RX_0x09)
+                    serial_io_xfer_end(SERIAL_IO_STATUS_DONE);
+                else if (((serial_io_txn_type == SERIAL_IO_TXN_RECEIVE) && (serial_io_phase != SERIAL_IO_PHASE_TX_FINAL)) ||
+                         (serial_io_phase == SERIAL_IO_PHASE_INIT_COUNTDOWN))
+                    serial_io_xfer_finish(SERIAL_IO_STATUS_FAILED);
+                else
+                    serial_io_xfer_end(SERIAL_IO_STATUS_FAILED);
+            }
+        }
+    }
+    return serial_io_status;
+}
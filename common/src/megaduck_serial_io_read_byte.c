@@ -0,0 +1,20 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_tick.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Waits for and returns a byte from Serial IO with NO timeout
+uint8_t serial_io_read_byte_no_timeout(void) {
+    CRITICAL {
+        serial_byte_recieved = false;
+    }
+
+    serial_io_enable_receive_byte();
+    MEGADUCK_WAIT_WHILE (!serial_byte_recieved);
+    return megaduck_serial_rx_data;
+}
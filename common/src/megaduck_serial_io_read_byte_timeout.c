@@ -0,0 +1,36 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_tick.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+#ifndef MEGADUCK_SERIAL_IO_ASM
+// In megaduck_serial_io_sm83.s when built with MEGADUCK_SERIAL_IO_ASM
+
+// Waits for a byte from Serial IO with a timeout
+// Returns:
+// - Timeout length is in msec (measured with the tick time base)
+// - If timed out: false
+// - If successful: true (rx byte will be in megaduck_serial_rx_data global)
+bool serial_io_read_byte_with_msecs_timeout(uint8_t timeout_len_ms) {
+    uint16_t timeout_ticks = MEGADUCK_TICKS_FROM_MSEC(timeout_len_ms);
+    uint16_t start;
+    CRITICAL {
+        serial_byte_recieved = false;
+    }
+
+    serial_io_enable_receive_byte();
+
+    start = megaduck_tick_now();
+    MEGADUCK_WAIT_WHILE ((uint16_t)(megaduck_tick_now() - start) < timeout_ticks) {
+        if (serial_byte_recieved)
+            return true;
+    }
+
+    return serial_byte_recieved;
+}
+#endif // MEGADUCK_SERIAL_IO_ASM
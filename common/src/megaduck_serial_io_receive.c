@@ -0,0 +1,23 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Sends a command and then receives a multi-byte buffer over Serial IO
+//
+// - Blocking version of serial_io_begin_command_and_receive_buffer(), with retries
+// - Reply payload goes into p_dest, size in: megaduck_serial_rx_buf_len
+// - Length of serial transfer: Determined by sender, up to max_len payload bytes
+// - Returns: true if succeeded
+//
+bool serial_io_send_command_and_receive_buffer(uint8_t io_cmd, uint8_t * p_dest, uint8_t max_len) {
+
+    if (serial_io_status == SERIAL_IO_STATUS_BUSY) return false;
+
+    serial_io_rx_setup_for_cmd(io_cmd, p_dest, max_len);
+    return serial_io_xfer_run(io_cmd, SERIAL_IO_TXN_RECEIVE);
+}
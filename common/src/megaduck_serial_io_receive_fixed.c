@@ -0,0 +1,21 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Sends a command and then receives a reply of exactly payload_len bytes
+//
+// - Blocking version of serial_io_begin_command_and_receive_fixed(), with retries
+// - Returns: true if succeeded (p_dest then holds payload_len bytes)
+//
+bool serial_io_send_command_and_receive_fixed(uint8_t io_cmd, uint8_t * p_dest, uint8_t payload_len) {
+
+    if (serial_io_status == SERIAL_IO_STATUS_BUSY) return false;
+
+    serial_io_rx_setup(p_dest, payload_len, payload_len + 2u);
+    return serial_io_xfer_run(io_cmd, SERIAL_IO_TXN_RECEIVE);
+}
@@ -0,0 +1,22 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Collects the outcome of a finished transaction
+//
+// - Makes the engine available for the next transaction
+// - Returns: true if the transaction succeeded, false if it failed or is still running
+bool serial_io_get_transaction_result(void) {
+
+    uint8_t status = serial_io_status;
+
+    if (status == SERIAL_IO_STATUS_BUSY) return false;
+
+    serial_io_status = SERIAL_IO_STATUS_IDLE;
+    return (status == SERIAL_IO_STATUS_DONE);
+}
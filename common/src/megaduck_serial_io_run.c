@@ -0,0 +1,36 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_tick.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Runs a transaction to completion, retrying it as set in serial_io_policy
+//
+// - Takes at most the worst case time documented for serial_io_policy_t
+bool serial_io_xfer_run(uint8_t io_cmd, uint8_t txn_type) {
+
+    uint16_t backoff = serial_io_policy.backoff_ticks;
+    uint8_t  retries = serial_io_policy.retries;
+
+    while (true) {
+        if (!serial_io_xfer_begin(io_cmd, txn_type)) return false;
+
+        MEGADUCK_WAIT_WHILE (serial_io_poll_transaction() == SERIAL_IO_STATUS_BUSY);
+        if (serial_io_get_transaction_result()) return true;
+
+        if (retries == 0u) return false;
+        retries--;
+
+        #ifdef MEGADUCK_LINK_STATS
+            megaduck_link_stats_count_retry(io_cmd);
+        #endif
+
+        // Give the peripheral a moment to drop whatever it was doing
+        megaduck_tick_wait(backoff);
+        backoff <<= 1;
+    }
+}
@@ -0,0 +1,24 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Sets up a reply for a command, using its fixed size when it has one
+//
+// - A fixed size that doesn't fit max_len falls back to the max_len check,
+//   so the buffer can never be overrun
+void serial_io_rx_setup_for_cmd(uint8_t io_cmd, uint8_t * p_dest, uint8_t max_len) {
+
+    uint8_t payload_len;
+
+    switch (io_cmd) {
+        case SYS_CMD_GET_KEYS:              payload_len = SYS_REPLY_KBD_PAYLOAD_LEN; break;
+        case SYS_CMD_RTC_GET_DATE_AND_TIME: payload_len = RTC_REPLY_PAYLOAD_LEN;     break;
+        default:                            payload_len = 0u;                        break;
+    }
+    serial_io_rx_setup(p_dest, max_len, ((payload_len != 0u) && (payload_len <= max_len)) ? (payload_len + 2u) : 0u);
+}
@@ -0,0 +1,19 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Sends a command and a multi-byte buffer over Serial IO
+//
+// - Blocking version of serial_io_begin_command_and_buffer(), with retries
+// - Send buffer globals: megaduck_serial_tx_buf, size in: megaduck_serial_tx_buf_len
+// - Length of serial transfer: Determined by megaduck_serial_tx_buf_len
+// - Returns: true if succeeded
+//
+bool serial_io_send_command_and_buffer(uint8_t io_cmd) {
+    return serial_io_xfer_run(io_cmd, SERIAL_IO_TXN_SEND);
+}
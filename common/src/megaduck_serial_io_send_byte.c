@@ -0,0 +1,46 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_tick.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+#if defined(MEGADUCK_SERIAL_IO_ASM) && (SERIAL_IO_TX_TURNAROUND_TICKS > 0u)
+    #error "megaduck_serial_io_sm83.s has no TX turnaround gap, build without USE_SERIAL_IO_ASM"
+#endif
+
+#ifndef MEGADUCK_SERIAL_IO_ASM
+// serial_io_send_byte() and serial_io_read_byte_with_msecs_timeout()
+// are in megaduck_serial_io_sm83.s when built with MEGADUCK_SERIAL_IO_ASM
+
+// Sends a byte out over serial IO
+//
+// - Instead of a fixed delay, waits until the hardware reports the
+//   transfer is done (~1 msec at the 8192 Hz internal clock), then
+//   only for the minimal turnaround gap before switching back to RX
+void serial_io_send_byte(uint8_t tx_byte) {
+
+    FF60_REG = FF60_REG_BEFORE_XFER;  // Seems optional in testing so far
+    SB_REG = tx_byte;
+    SC_REG = SIOF_XFER_START | SIOF_CLOCK_INT;
+
+    uint16_t start = megaduck_tick_now();
+    MEGADUCK_WAIT_WHILE ((SC_REG & SIOF_XFER_START) &&
+                         ((uint16_t)(megaduck_tick_now() - start) < SERIAL_IO_TX_TIMEOUT_TICKS));
+    serial_io_tx_ticks_measured = (uint8_t)(megaduck_tick_now() - start);
+
+    #if (SERIAL_IO_TX_TURNAROUND_TICKS > 0u)
+        megaduck_tick_wait(SERIAL_IO_TX_TURNAROUND_TICKS);
+    #endif
+
+    // Restore to SIO input and clear pending Serial interrupt,
+    // other pending flags (VBlank, Timer, ...) are left for their handlers
+    CRITICAL {
+        IF_REG &= ~SIO_IFLAG;
+    }
+    SC_REG = SIOF_XFER_START | SIOF_CLOCK_EXT;
+}
+#endif // MEGADUCK_SERIAL_IO_ASM
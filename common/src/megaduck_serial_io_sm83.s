@@ -0,0 +1,139 @@
+;
+; Optional SM83 versions of the serial byte primitives in megaduck_laptop_io.c
+;
+; Built instead of the C versions with USE_SERIAL_IO_ASM=1 in the example
+; Makefiles, which also defines MEGADUCK_SERIAL_IO_ASM for the C side
+;
+; - Same register accesses in the same order as the C versions
+; - Timeouts count TIMA directly with the state kept in registers, instead
+;   of going through megaduck_tick_now() and its critical section each loop.
+;   The tick count is untouched, megaduck_tick_now() folds in the elapsed
+;   TIMA counts on its next call like it would after any other wait
+; - Checked by tools/megaduck_sm83_check.py (run from make -C host run)
+; - Calling convention is SDCC's sdcccall(1) for SM83 (GBDK-2020 4.1+):
+;   first uint8_t argument in A, bool / uint8_t result in A, all registers
+;   may be changed
+;
+; Must match megaduck_laptop_io.h
+FF60_REG_BEFORE_XFER         = 0x00
+SERIAL_IO_TX_TIMEOUT_TICKS   = 8        ; MEGADUCK_TICKS_FROM_MSEC(TIMEOUT_2_MSEC)
+SIOF_XFER_START              = 0x80
+SIOF_CLOCK_INT               = 0x01
+SIOF_CLOCK_EXT               = 0x00
+SIO_IFLAG                    = 0x08
+
+        .include        "global.s"
+
+        .globl  _serial_byte_recieved
+        .globl  _serial_io_tx_ticks_measured
+
+        .area   _CODE
+
+
+; void serial_io_send_byte(uint8_t tx_byte)
+;
+; - A: byte to send
+_serial_io_send_byte::
+        ld      c, a
+
+        ld      a, #FF60_REG_BEFORE_XFER
+        ldh     (0x60), a                       ; FF60_REG
+        ld      a, c
+        ldh     (.SB), a
+        ld      a, #(SIOF_XFER_START | SIOF_CLOCK_INT)
+        ldh     (.SC), a
+
+        ; Wait for the transfer to finish, or the TX timeout
+        ldh     a, (.TIMA)
+        ld      b, a                            ; B: TIMA at start
+1$:
+        ldh     a, (.SC)
+        add     a, a                            ; SIOF_XFER_START -> carry
+        jr      nc, 2$
+        ldh     a, (.TIMA)
+        sub     b
+        cp      #SERIAL_IO_TX_TIMEOUT_TICKS
+        jr      c, 1$
+2$:
+        ldh     a, (.TIMA)
+        sub     b
+        ld      (_serial_io_tx_ticks_measured), a
+
+        ; Restore to SIO input and clear a pending Serial interrupt,
+        ; a single res instruction leaves the other IF bits alone
+        ld      hl, #(0xFF00 + .IF)
+        res     3, (hl)                         ; SIO_IFLAG
+        ld      a, #(SIOF_XFER_START | SIOF_CLOCK_EXT)
+        ldh     (.SC), a
+        ret
+
+
+; bool serial_io_read_byte_with_msecs_timeout(uint8_t timeout_len_ms)
+;
+; - A: timeout in msec
+; - Returns true if a byte arrived (it's in megaduck_serial_rx_data)
+_serial_io_read_byte_with_msecs_timeout::
+        ; HL: timeout in ticks = (ms << 2) + (ms >> 3), same as MEGADUCK_TICKS_FROM_MSEC()
+        ld      c, a
+        ld      l, a
+        ld      h, #0
+        add     hl, hl
+        add     hl, hl
+        ld      a, c
+        srl     a
+        srl     a
+        srl     a
+        add     a, l
+        ld      l, a
+        ld      a, h
+        adc     a, #0
+        ld      h, a
+
+        ; A single byte store doesn't need the critical section the C version uses
+        xor     a
+        ld      (_serial_byte_recieved), a
+
+        ; serial_io_enable_receive_byte()
+        ld      a, #FF60_REG_BEFORE_XFER
+        ldh     (0x60), a                       ; FF60_REG
+        ld      a, #(SIOF_XFER_START | SIOF_CLOCK_EXT)
+        ldh     (.SC), a
+        ; Clear a pending Serial interrupt through A, HL holds the timeout
+        di
+        ldh     a, (.IF)
+        and     #~SIO_IFLAG
+        ldh     (.IF), a
+        ldh     a, (.IE)
+        or      #SIO_IFLAG
+        ldh     (.IE), a
+        ei
+
+        ; DE: ticks elapsed, B: last TIMA
+        ld      de, #0
+        ldh     a, (.TIMA)
+        ld      b, a
+1$:
+        ld      a, (_serial_byte_recieved)
+        or      a
+        ret     nz                              ; Received: A = true
+
+        ldh     a, (.TIMA)
+        ld      c, a
+        sub     b
+        ld      b, c
+        add     a, e
+        ld      e, a
+        ld      a, d
+        adc     a, #0
+        ld      d, a
+
+        ; Loop while DE < HL
+        ld      a, e
+        sub     l
+        ld      a, d
+        sbc     a, h
+        jr      c, 1$
+
+        ; Timed out, a byte may still have arrived on the last check
+        ld      a, (_serial_byte_recieved)
+        ret
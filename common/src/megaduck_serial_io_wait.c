@@ -0,0 +1,23 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_tick.h>
+
+#include "megaduck_laptop_io_internal.h"
+
+
+// Waits for a serial transfer to complete with a timeout
+//
+// - Timeout length is in msec (measured with the tick time base)
+// - Serial ISR populates status var if anything was received
+void serial_io_wait_for_transfer_with_timeout(uint8_t timeout_len_ms) {
+    uint16_t timeout_ticks = MEGADUCK_TICKS_FROM_MSEC(timeout_len_ms);
+    uint16_t start = megaduck_tick_now();
+
+    MEGADUCK_WAIT_WHILE ((uint16_t)(megaduck_tick_now() - start) < timeout_ticks) {
+        if (serial_byte_recieved)
+            return;
+    }
+}
@@ -0,0 +1,78 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_tick.h>
+
+
+volatile uint16_t megaduck_tick_count;
+static   uint8_t  megaduck_tick_tima_last;
+static   bool     megaduck_tick_running = false;
+
+
+static void megaduck_tick_vbl_isr(void);
+
+
+// TIMA wraps every 256 ticks (62.5 msec), so it gets sampled
+// once per frame as well to keep the count monotonic even
+// when nothing else is reading it for a while
+static void megaduck_tick_vbl_isr(void) {
+    megaduck_tick_now_isr();
+}
+
+
+// Starts the tick time base
+//
+// - Takes over the hardware timer: TIMA at 4096 Hz, TMA = 0
+// - Safe to call more than once
+void megaduck_tick_init(void) {
+
+    if (megaduck_tick_running) return;
+
+    CRITICAL {
+        TMA_REG  = 0x00u;
+        TIMA_REG = 0x00u;
+        TAC_REG  = TACF_START | TACF_4KHZ;
+        megaduck_tick_tima_last = 0u;
+        add_VBL(megaduck_tick_vbl_isr);
+    }
+    megaduck_tick_running = true;
+}
+
+
+// Returns the current tick count
+//
+// - Folds the TIMA delta since the last call into the 16 bit count
+// - Compare with: (uint16_t)(megaduck_tick_now() - start) >= duration
+// - Main loop only: the critical section turns interrupts back on when
+//   it ends, use megaduck_tick_now_isr() where they are already off
+uint16_t megaduck_tick_now(void) {
+    uint16_t now;
+
+    CRITICAL {
+        now = megaduck_tick_now_isr();
+    }
+    return now;
+}
+
+
+// Same as megaduck_tick_now(), without the critical section
+//
+// - For callers that already run with interrupts off
+//   (interrupt handlers, or inside a CRITICAL block)
+uint16_t megaduck_tick_now_isr(void) {
+
+    // Read TIMA once, before using the saved state
+    uint8_t tima = TIMA_REG;
+    megaduck_tick_count += (uint8_t)(tima - megaduck_tick_tima_last);
+    megaduck_tick_tima_last = tima;
+    return megaduck_tick_count;
+}
+
+
+// Waits for a number of ticks
+void megaduck_tick_wait(uint16_t ticks) {
+    uint16_t start = megaduck_tick_now();
+
+    MEGADUCK_WAIT_WHILE ((uint16_t)(megaduck_tick_now() - start) < ticks);
+}
@@ -7,16 +7,23 @@
 #include <stdio.h>
 
 #include <megaduck_laptop_io.h>
+#include <megaduck_link_sched.h>
+#include <megaduck_link_overlay.h>
+#include <megaduck_link_trace.h>
 #include <megaduck_model.h>
 
 #include "megaduck_keyboard.h"
+#include "megaduck_key2ascii.h"
+#include "megaduck_piano.h"
+#include "megaduck_vblank_test.h"
 
 bool megaduck_laptop_detected = false;
 
 uint8_t cursor_x, cursor_y;
 
-bool keyboard_read_ok;
-bool logging_enabled = false;
+uint8_t keyboard_status;
+megaduck_key_event_t key_event;
+bool overlay_enabled = false;
 
 // A dashed underscore cursor
 const uint8_t cursor_tile[16] = {
@@ -32,8 +39,12 @@ const uint8_t cursor_tile[16] = {
 
 #define SPR_CURSOR 0u
 
+// Keyboard poll interval, the link scheduler keeps polls at least 20 msec apart
+// (Polling intervals below 20ms may cause keyboard lockup)
+// Key repeat is timed separately, so this only sets how quickly new keys show up
+#define KEYBOARD_POLL_FRAMES 2u
+
 static void update_cursor(int8_t delta_x, int8_t delta_y);
-static void log_key_data(void);
 static void use_keypress_data(void);
 static void main_init(void);
 
@@ -41,6 +52,10 @@ static void main_init(void);
 
 static void main_init(void) {
 
+    // Start the laptop init first, it runs in the background
+    // while the rest of the setup happens
+    megaduck_laptop_init_begin();
+
     // Set up sprite cursor
     set_sprite_data(0,1,cursor_tile);
     set_sprite_tile(SPR_CURSOR,0);
@@ -51,28 +66,9 @@ static void main_init(void) {
     SHOW_BKG;
     printf("Initializing..\n");
 
-    megaduck_laptop_detected = megaduck_laptop_init();
-}
-
-
-// If requested, log some data about the incoming keyboard packet
-static void log_key_data(void) {
-
-    printf("*%hx %hx %hx %hx=",
-        (uint8_t)megaduck_io_packet_length,
-        (uint8_t)megaduck_key_flags,
-        (uint8_t)megaduck_key_code,
-        (uint8_t)megaduck_io_checksum_calc);
-
-//    printf("*%hx %hx %hx %hx:%hx=%c\n",
-//        (uint8_t)megaduck_io_packet_length,
-//        (uint8_t)megaduck_key_flags,
-//        (uint8_t)megaduck_key_code,
-//        (uint8_t)megaduck_io_checksum_calc,
-//        (uint8_t)keyboard_read_ok,
-//        (char)megaduck_key_pressed);
-//
-//    putchar(megaduck_key_pressed);
+    while (megaduck_laptop_init_status() == MEGADUCK_LAPTOP_INIT_PENDING)
+        vsync();
+    megaduck_laptop_detected = (megaduck_laptop_init_status() == MEGADUCK_LAPTOP_INIT_OK);
 }
 
 
@@ -95,7 +91,13 @@ static void use_keypress_data(void) {
         case KEY_ARROW_LEFT:  update_cursor(-1,  0); break;
         case KEY_ARROW_RIGHT: update_cursor( 1,  0); break;
 
-        case KEY_ESCAPE: logging_enabled = !logging_enabled; break;
+        // Shows link statistics (when built with MEGADUCK_LINK_STATS)
+        case KEY_ESCAPE:
+            overlay_enabled = !overlay_enabled;
+            #ifdef MEGADUCK_LINK_STATS
+                megaduck_link_overlay_show(overlay_enabled);
+            #endif
+            break;
 
         // Clears the screen
         case KEY_HELP:
@@ -126,6 +128,7 @@ static void use_keypress_data(void) {
 void main(void) {
 	
     megaduck_laptop_check_model_vram_on_startup();  // This must be called before any vram tiles are loaded
+    megaduck_keymap_select(megaduck_model);
 
     main_init();
 
@@ -140,29 +143,50 @@ void main(void) {
         else if (megaduck_model == MEGADUCK_LAPTOP_GERMAN)
             printf("German model\n");
 
+	    #ifdef MEGADUCK_VBLANK_TEST
+	        megaduck_vblank_test_run();
+	    #endif
+
 	    update_cursor(1,1);
 
+	    megaduck_piano_init();
+	    megaduck_sched_init();
+	    megaduck_keyboard_schedule_keys(KEYBOARD_POLL_FRAMES);
+
 		while(1) {
 		    vsync();
 
-		    // Poll for keys every other frame
-		    // (Polling intervals below 20ms may cause keyboard lockup)
-		    if (sys_time & 0x01u) {
+            #ifdef MEGADUCK_LINK_STATS
+                // One row per frame while still in VBlank
+                if (overlay_enabled)
+                    megaduck_link_overlay_update();
+            #endif
 
-		        keyboard_read_ok = megaduck_keyboard_poll_keys();
+		    // Collect the finished keyboard poll and start the next one,
+		    // the serial transfer runs in the background meanwhile
+		    megaduck_sched_update();
+		    keyboard_status = megaduck_keyboard_get_scheduled_keys();
 
-		            if (logging_enabled)
-		                log_key_data();
+		    if (keyboard_status == SERIAL_IO_STATUS_DONE) {
+		        // Piano keys go straight to the APU, in the same pass the reply arrived in
+		        while (megaduck_keyboard_get_event(&key_event))
+		            megaduck_piano_key_event(&key_event);
 
-		        if (keyboard_read_ok) {
-		            // Convert from keycodes to ascii and apply key repeat
-		            megaduck_keyboard_process_keys();
+		        // Convert from keycodes to ascii and apply key repeat
+		        megaduck_keyboard_process_keys();
 
-		            use_keypress_data();
-		        }
-	            if (logging_enabled)
-                    putchar('\n');
+		        use_keypress_data();
 		    }
+		    else if (megaduck_keyboard_repeat_keys()) {
+		        // Key repeats between polls (or while polls fail) keep their pace
+		        use_keypress_data();
+		    }
+
+            #ifdef MEGADUCK_LINK_TRACE
+		    // Save the link traffic leading up to a failed poll, SRAM keeps the latest one
+		    if (keyboard_status == SERIAL_IO_STATUS_FAILED)
+		        megaduck_link_trace_flush();
+            #endif
 		}
 	}
 }
@@ -1,9 +1,53 @@
 #include <gbdk/platform.h>
 #include <stdint.h>
 
+#include <megaduck_keycodes.h>
+#include <megaduck_model.h>
+
 #ifndef _MEGADUCK_KEY2ASCII_H
 #define _MEGADUCK_KEY2ASCII_H
 
-char megaduck_keycode_to_ascii(const uint8_t key_code);
+// Keymap tables are generated at build time from the layout files
+// in layouts/ by tools/megaduck_keymap_gen.py (see megaduck_keymaps.c in obj/)
+//
+// Built with MEGADUCK_BANKED they are in a switchable ROM bank, so only
+// read them through megaduck_keymap_select() / megaduck_keycode_to_ascii()
+//
+// Each layout has a plain and a shift half of 4 rows (key_code & 0x03), indexed by the
+// column (key_code - MEGADUCK_KEY_BASE) >> 2. Caps Lock gives the shift character of
+// letters, Caps Lock + Shift the plain one
+#define KEYMAP_MOD_FLAGS  (MEGADUCK_KEY_FLAG_CAPSLOCK | MEGADUCK_KEY_FLAG_SHIFT)
+#define KEYMAP_ROW_MASK   0x03u
+#define KEYMAP_COL_SHIFT  2u
+#define KEYMAP_ROW_COUNT  4u
+#define KEYMAP_HALF_COUNT 2u  // Plain, shift
+
+// Characters are single byte code page 437 values
+typedef struct megaduck_keymap_row_t {
+    uint8_t offset;  // Index in p_chars of the row's first column
+    uint8_t first;   // Column of p_chars[offset]
+    uint8_t count;   // Columns past the end of the row are NO_KEY
+} megaduck_keymap_row_t;
+
+// A key that differs from the rows, for layouts sharing their base layout's rows
+typedef struct megaduck_keymap_key_t {
+    uint8_t code;
+    char    plain;
+    char    shift;
+} megaduck_keymap_key_t;
+
+typedef struct megaduck_keymap_t {
+    const char *                  p_chars;
+    megaduck_keymap_row_t         rows[KEYMAP_HALF_COUNT][KEYMAP_ROW_COUNT];
+    const megaduck_keymap_key_t * p_keys;  // Checked before the rows
+    uint8_t                       key_count;
+} megaduck_keymap_t;
+
+extern const megaduck_keymap_t * const megaduck_keymaps_by_model[MEGADUCK_MODEL_COUNT];
+extern const megaduck_keymap_t * p_megaduck_keymap;
+extern const char megaduck_keymap_caps_letters[];  // NO_KEY terminated, besides a-z
+
+void megaduck_keymap_select(uint8_t model) NONBANKED;
+char megaduck_keycode_to_ascii(const uint8_t key_code, const uint8_t key_flags) NONBANKED;
 
 #endif // _MEGADUCK_KEY2ASCII_H
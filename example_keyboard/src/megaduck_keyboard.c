@@ -3,6 +3,7 @@
 #include <stdbool.h>
 
 #include <megaduck_laptop_io.h>
+#include <megaduck_link_sched.h>
 #include <megaduck_keycodes.h>
 
 #include "megaduck_key2ascii.h"
@@ -14,15 +15,30 @@ uint8_t megaduck_key_flags;
 uint8_t megaduck_key_code;
 uint8_t megaduck_io_checksum_calc;
 
-#define REPEAT_OFF                 0u
-#define REPEAT_FIRST_THRESHOLD     8u
-#define REPEAT_CONTINUE_THRESHOLD  4u
-
 char megaduck_key_pressed        = NO_KEY;
 char megaduck_key_previous       = NO_KEY;
 bool keyboard_repeat_allowed     = false;
 uint8_t megaduck_key_flags           = 0x00u;
-uint8_t keyboard_repeat_timeout  = REPEAT_OFF;
+
+// Key repeat timing in frames, see megaduck_keyboard_repeat_keys()
+uint8_t megaduck_key_repeat_delay = KEY_REPEAT_DELAY_FRAMES_DEFAULT;
+uint8_t megaduck_key_repeat_rate  = KEY_REPEAT_RATE_FRAMES_DEFAULT;
+static uint16_t keyboard_repeat_next;  // sys_time the next repeat is due
+static uint16_t keyboard_repeat_seen;  // sys_time a poll last reported the key still down
+
+// Key event queue and held key state, filled at poll time
+static megaduck_key_event_t key_event_queue[KEY_EVENT_QUEUE_SZ];
+static uint8_t key_event_head = 0u;  // Next event to read
+static uint8_t key_event_tail = 0u;  // Next free slot
+static uint8_t key_held_code  = 0x00u;  // Scan code of key currently held, 0x00 if none
+
+// Result of the latest scheduled keyboard poll
+static uint8_t keyboard_sched_status = SERIAL_IO_STATUS_IDLE;
+
+uint8_t megaduck_keys_held[256u / 8u];
+uint8_t megaduck_key_events_dropped = 0u;
+
+const uint8_t megaduck_key_bit_mask[8] = { 0x01u, 0x02u, 0x04u, 0x08u, 0x10u, 0x20u, 0x40u, 0x80u };
 
 
 // RX Bytes for Keyboard Serial Reply Packet
@@ -43,6 +59,97 @@ uint8_t keyboard_repeat_timeout  = REPEAT_OFF;
 
 
 
+// Adds an event to the queue, if there is room
+static void megaduck_keyboard_queue_event(uint8_t key_code, uint8_t edge) {
+
+    megaduck_key_event_t * p_event;
+
+    if ((uint8_t)(key_event_tail - key_event_head) >= KEY_EVENT_QUEUE_SZ) {
+        megaduck_key_events_dropped++;
+        return;
+    }
+
+    p_event = &key_event_queue[key_event_tail & KEY_EVENT_QUEUE_MASK];
+    p_event->key_code = key_code;
+    p_event->flags    = megaduck_key_flags;
+    p_event->edge     = edge;
+    p_event->time     = sys_time;
+    key_event_tail++;
+}
+
+
+// Releases the currently held key, if any
+static void megaduck_keyboard_release_held(void) {
+
+    if (key_held_code) {
+        megaduck_keys_held[key_held_code >> 3] &= ~megaduck_key_bit_mask[key_held_code & 0x07u];
+        megaduck_keyboard_queue_event(key_held_code, KEY_EVENT_RELEASE);
+        key_held_code = 0x00u;
+    }
+}
+
+
+// Turns the latest key data into press / repeat / release events
+//
+// The keyboard reports one key at a time:
+// - A key code (no repeat flag) when a key goes down
+// - The repeat flag with no key code while it stays down
+// - No key code and no repeat flag once it's released
+static void megaduck_keyboard_update_events(void) {
+
+    if (megaduck_key_flags & KEY_FLAG_KEY_REPEAT) {
+        if (key_held_code)
+            megaduck_keyboard_queue_event(key_held_code, KEY_EVENT_REPEAT);
+        return;
+    }
+
+    // Any key code (even the same one again) means a new press,
+    // so the previous key must have gone up in between
+    megaduck_keyboard_release_held();
+
+    if (megaduck_key_code) {
+        key_held_code = megaduck_key_code;
+        megaduck_keys_held[key_held_code >> 3] |= megaduck_key_bit_mask[key_held_code & 0x07u];
+        megaduck_keyboard_queue_event(key_held_code, KEY_EVENT_PRESS);
+    }
+}
+
+
+// Loads key data from a successful keyboard request
+//
+// - Keyboard replies are received with their fixed size, so a
+//   successful one always holds exactly the 2 payload bytes
+static void megaduck_keyboard_load_reply(void) {
+
+    megaduck_key_flags = megaduck_serial_rx_buf[0];
+    megaduck_key_code  = megaduck_serial_rx_buf[1];
+
+    // Rebuild the packet header and checksum (already verified by the transaction)
+    megaduck_io_packet_length = SYS_REPLY_KBD_PAYLOAD_LEN + 2u;
+    megaduck_io_checksum_calc = ~(uint8_t)(megaduck_io_packet_length + megaduck_key_flags + megaduck_key_code) + 1u;
+    megaduck_keyboard_update_events();
+}
+
+
+// Gets the oldest queued key event
+//
+// Returns false if there are no events waiting
+bool megaduck_keyboard_get_event(megaduck_key_event_t * p_event) {
+
+    if (key_event_head == key_event_tail) return false;
+
+    *p_event = key_event_queue[key_event_head & KEY_EVENT_QUEUE_MASK];
+    key_event_head++;
+    return true;
+}
+
+
+// Discards all queued key events (held key state is kept)
+void megaduck_keyboard_flush_events(void) {
+    key_event_head = key_event_tail;
+}
+
+
 // Request keyboard input and handle the response
 //
 // Returns success or failure, resulting key data is in:
@@ -50,55 +157,139 @@ uint8_t keyboard_repeat_timeout  = REPEAT_OFF;
 //
 bool megaduck_keyboard_poll_keys(void) {
 
-    if (serial_io_send_command_and_receive_buffer(SYS_CMD_GET_KEYS)) {
-        if (megaduck_serial_rx_buf_len == SYS_REPLY_KBD_LEN) {
-            megaduck_key_flags = megaduck_serial_rx_buf[0];
-            megaduck_key_code  = megaduck_serial_rx_buf[1];
-            return true;
-        }
+    if (serial_io_receive_keys(megaduck_serial_rx_buf)) {
+        megaduck_keyboard_load_reply();
+        return true;
     }
     return false;
 }
 
 
-// Translates key codes to ascii
-// Handles Shift/Caps Lock and Repeat flags
-void megaduck_keyboard_process_keys(void) {
+// Starts a keyboard request without waiting for the reply
+//
+// Returns false if a serial transaction is already in progress
+bool megaduck_keyboard_request_keys(void) {
+
+    return serial_io_begin_receive_keys(megaduck_serial_rx_buf);
+}
+
 
-    // Key repeat processing is optional
-    if ((megaduck_key_flags & KEY_FLAG_KEY_REPEAT) && (keyboard_repeat_allowed)) {
+// Checks on a request started with megaduck_keyboard_request_keys()
+//
+// Returns:
+// - SERIAL_IO_STATUS_IDLE or SERIAL_IO_STATUS_BUSY: nothing new yet
+// - SERIAL_IO_STATUS_DONE: resulting key data is in megaduck_key_flags & megaduck_key_code
+// - SERIAL_IO_STATUS_FAILED: request failed
+uint8_t megaduck_keyboard_check_keys(void) {
 
-        // Default to no key repeat
-        megaduck_key_pressed = NO_KEY;
+    uint8_t status = serial_io_poll_transaction();
 
-        if (keyboard_repeat_timeout) {
-            keyboard_repeat_timeout--;
-        } else {
-            // Small delay than initial threshold until next repeat
-            megaduck_key_pressed = megaduck_key_previous;
-            keyboard_repeat_timeout = REPEAT_CONTINUE_THRESHOLD;
-        }
+    if ((status == SERIAL_IO_STATUS_IDLE) || (status == SERIAL_IO_STATUS_BUSY))
+        return status;
+
+    if (serial_io_get_transaction_result()) {
+        megaduck_keyboard_load_reply();
+        return SERIAL_IO_STATUS_DONE;
     }
-    else {
-        megaduck_key_flags = megaduck_key_flags;
-        uint8_t temp_megaduck_key_code = megaduck_key_code;
+    return SERIAL_IO_STATUS_FAILED;
+}
+
+
+// Link scheduler completion for the keyboard slot
+static void megaduck_keyboard_sched_complete(bool ok) {
 
-        // If only shift is enabled, use keycode translation for shift alternate keys (-= 0x80u)
-        if ((megaduck_key_flags & (KEY_FLAG_CAPSLOCK | KEY_FLAG_SHIFT)) == KEY_FLAG_SHIFT)
-            temp_megaduck_key_code -= MEGADUCK_KEY_BASE;
+    if (ok) {
+        megaduck_keyboard_load_reply();
+        keyboard_sched_status = SERIAL_IO_STATUS_DONE;
+    } else
+        keyboard_sched_status = SERIAL_IO_STATUS_FAILED;
+}
+
+
+// Has the link scheduler poll the keyboard every period_frames
+//
+// - megaduck_sched_init() must have been called first
+// - Periods shorter than the scheduler spacing just run as often as the spacing allows
+void megaduck_keyboard_schedule_keys(uint16_t period_frames) {
+
+    keyboard_sched_status = SERIAL_IO_STATUS_IDLE;
+    megaduck_sched_add(MEGADUCK_SCHED_SLOT_KEYBOARD, SYS_CMD_GET_KEYS, MEGADUCK_SCHED_RECEIVE,
+                       period_frames, NULL, megaduck_keyboard_sched_complete);
+}
 
-        megaduck_key_pressed = megaduck_keycode_to_ascii(temp_megaduck_key_code);
 
-        // If only caps lock is enabled, just translate a-z -> A-Z with no other shift alternates
-        if ((megaduck_key_flags & (KEY_FLAG_CAPSLOCK | KEY_FLAG_SHIFT)) == KEY_FLAG_CAPSLOCK)
-            if ((megaduck_key_pressed >= 'a') && (megaduck_key_pressed <= 'z'))
-                megaduck_key_pressed -= ('a' - 'A');
+// Gets the result of the latest scheduled keyboard poll
+//
+// Call after megaduck_sched_update(), each result is only returned once
+//
+// Returns:
+// - SERIAL_IO_STATUS_IDLE: no poll has finished since the last call
+// - SERIAL_IO_STATUS_DONE: resulting key data is in megaduck_key_flags & megaduck_key_code
+// - SERIAL_IO_STATUS_FAILED: poll failed
+uint8_t megaduck_keyboard_get_scheduled_keys(void) {
+
+    uint8_t status = keyboard_sched_status;
+
+    keyboard_sched_status = SERIAL_IO_STATUS_IDLE;
+    return status;
+}
+
+
+// Synthesizes key repeats for the last key pressed, timed in frames
+//
+// - Call once per frame when there is no new keyboard reply to process
+//   (megaduck_keyboard_process_keys() calls it for hardware repeat replies),
+//   so repeats keep their pace no matter how often the keyboard is polled
+// - Repeats stop on the release reply, or once no successful poll has seen
+//   the key held for KEY_REPEAT_HOLD_TIMEOUT_FRAMES (ex: the link went down)
+//
+// Returns true when a repeat is due, the repeated key is in megaduck_key_pressed
+bool megaduck_keyboard_repeat_keys(void) {
+
+    uint16_t now = sys_time;
+
+    megaduck_key_pressed = NO_KEY;
+
+    if (!keyboard_repeat_allowed) return false;
+
+    if ((uint16_t)(now - keyboard_repeat_seen) > KEY_REPEAT_HOLD_TIMEOUT_FRAMES) {
+        keyboard_repeat_allowed = false;
+        return false;
+    }
+
+    if ((int16_t)(now - keyboard_repeat_next) < 0) return false;
+
+    // Keep the cadence, but restart it from now instead of
+    // bursting out repeats if this wasn't called for a while
+    keyboard_repeat_next += megaduck_key_repeat_rate;
+    if ((int16_t)(now - keyboard_repeat_next) >= 0)
+        keyboard_repeat_next = now + megaduck_key_repeat_rate;
+
+    megaduck_key_pressed = megaduck_key_previous;
+    return true;
+}
+
+
+// Translates key codes to ascii
+// Handles Shift/Caps Lock and Repeat flags
+void megaduck_keyboard_process_keys(void) {
+
+    if (megaduck_key_flags & KEY_FLAG_KEY_REPEAT) {
+        // Hardware repeat replies only say the key is still down,
+        // the repeats themselves come from the repeat timer
+        keyboard_repeat_seen = sys_time;
+        megaduck_keyboard_repeat_keys();
+    }
+    else {
+        // Caps Lock and Shift are handled by the keymap lookup
+        megaduck_key_pressed = megaduck_keycode_to_ascii(megaduck_key_code, megaduck_key_flags);
 
         // Repeat ok for ascii 32 (space) and higher + arrow keys
-        if ((megaduck_key_pressed >= ' ') ||
+        if (((uint8_t)megaduck_key_pressed >= ' ') ||
             ((megaduck_key_pressed >= KEY_ARROW_UP) && (megaduck_key_pressed <= KEY_ARROW_LEFT))) {
             keyboard_repeat_allowed = true;
-            keyboard_repeat_timeout = REPEAT_FIRST_THRESHOLD;
+            keyboard_repeat_seen    = sys_time;
+            keyboard_repeat_next    = sys_time + megaduck_key_repeat_delay;
         } else
             keyboard_repeat_allowed = false;
 
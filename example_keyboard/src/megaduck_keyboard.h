@@ -31,6 +31,31 @@
 #define KEY_FLAG_PRINTSCREEN_LEFT_BIT    3u
 
 
+// Key repeat timing defaults, in frames
+#define KEY_REPEAT_DELAY_FRAMES_DEFAULT  18u  // ~300 msec held before the first repeat
+#define KEY_REPEAT_RATE_FRAMES_DEFAULT   10u  // Then a repeat every ~170 msec
+// Repeats stop if no poll has seen the key held for this long,
+// must be longer than the keyboard poll interval
+#define KEY_REPEAT_HOLD_TIMEOUT_FRAMES   30u
+
+
+// Key event edge types
+#define KEY_EVENT_PRESS                  0u
+#define KEY_EVENT_REPEAT                 1u  // Key still held (hardware repeat packet)
+#define KEY_EVENT_RELEASE                2u
+
+// Size of key event queue, must be a power of 2
+#define KEY_EVENT_QUEUE_SZ               16u
+#define KEY_EVENT_QUEUE_MASK             (KEY_EVENT_QUEUE_SZ - 1u)
+
+typedef struct megaduck_key_event_t {
+    uint8_t  key_code;  // Raw scan code (MEGADUCK_KEY_*)
+    uint8_t  flags;     // Modifier flags (KEY_FLAG_*) at the time of the event
+    uint8_t  edge;      // KEY_EVENT_*
+    uint16_t time;      // sys_time of the poll that saw it
+} megaduck_key_event_t;
+
+
 // Raw key data
 extern uint8_t megaduck_io_packet_length;
 extern uint8_t megaduck_key_flags;
@@ -43,9 +68,32 @@ extern char    megaduck_key_pressed;
 extern char    megaduck_key_previous;
 extern uint8_t megaduck_key_flags;
 
+// Key repeat timing in frames, can be changed at any time
+extern uint8_t megaduck_key_repeat_delay;
+extern uint8_t megaduck_key_repeat_rate;
 
-bool megaduck_keyboard_poll_keys(void);
+
+// Held key state, one bit per scan code
+extern uint8_t megaduck_keys_held[256u / 8u];
+extern const uint8_t megaduck_key_bit_mask[8];
+extern uint8_t megaduck_key_events_dropped;
+
+// Returns non-zero if the key with the given scan code is currently held
+static inline uint8_t megaduck_keyboard_key_held(uint8_t key_code) {
+    return megaduck_keys_held[key_code >> 3] & megaduck_key_bit_mask[key_code & 0x07u];
+}
+
+
+bool    megaduck_keyboard_poll_keys(void);
+bool    megaduck_keyboard_request_keys(void);
+uint8_t megaduck_keyboard_check_keys(void);
+void    megaduck_keyboard_schedule_keys(uint16_t period_frames);
+uint8_t megaduck_keyboard_get_scheduled_keys(void);
 void megaduck_keyboard_process_keys(void);
+bool megaduck_keyboard_repeat_keys(void);
+
+bool    megaduck_keyboard_get_event(megaduck_key_event_t * p_event);
+void    megaduck_keyboard_flush_events(void);
 
 
 #endif // _MEGADUCK_KEYBOARD_H
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_keycodes.h>
+
+#include "megaduck_keyboard.h"
+#include "megaduck_piano.h"
+
+
+#define PIANO_VOICE_PULSE_1  0u
+#define PIANO_VOICE_PULSE_2  1u
+#define PIANO_VOICE_WAVE     2u
+
+#define PIANO_TRIGGER        0x80u  // NRx4: restart the channel
+#define PIANO_DUTY_25        0x40u  // NRx1
+#define PIANO_WAVE_DAC_ON    0x80u  // NR30
+#define PIANO_WAVE_VOL_100   0x20u  // NR32
+
+// Envelope: full volume, decaying one step every 3/64 sec like a struck string
+// - The Mega Duck has the two nibbles of the envelope registers swapped
+#ifdef __TARGET_duck
+    #define PIANO_ENVELOPE   0x3Fu
+#else
+    #define PIANO_ENVELOPE   0xF3u
+#endif
+#define PIANO_ENVELOPE_OFF   0x00u  // Volume 0 and decreasing turns the channel DAC off
+
+// Scan code lookup covers DO_SHARP (lowest piano scan code) .. SI_2 (highest)
+#define PIANO_KEY_FIRST      MEGADUCK_KEY_PIANO_DO_SHARP
+#define PIANO_KEY_COUNT      (MEGADUCK_KEY_PIANO_SI_2 - MEGADUCK_KEY_PIANO_DO_SHARP + 1u)
+
+// Note + 1 for each piano scan code, 0 for the other keys mixed in between
+static const uint8_t piano_note_by_key[PIANO_KEY_COUNT] = {
+    [MEGADUCK_KEY_PIANO_DO        - PIANO_KEY_FIRST] =  1u,
+    [MEGADUCK_KEY_PIANO_DO_SHARP  - PIANO_KEY_FIRST] =  2u,
+    [MEGADUCK_KEY_PIANO_RE        - PIANO_KEY_FIRST] =  3u,
+    [MEGADUCK_KEY_PIANO_RE_SHARP  - PIANO_KEY_FIRST] =  4u,
+    [MEGADUCK_KEY_PIANO_MI        - PIANO_KEY_FIRST] =  5u,
+    [MEGADUCK_KEY_PIANO_FA        - PIANO_KEY_FIRST] =  6u,
+    [MEGADUCK_KEY_PIANO_FA_SHARP  - PIANO_KEY_FIRST] =  7u,
+    [MEGADUCK_KEY_PIANO_SOL       - PIANO_KEY_FIRST] =  8u,
+    [MEGADUCK_KEY_PIANO_SOL_SHARP - PIANO_KEY_FIRST] =  9u,
+    [MEGADUCK_KEY_PIANO_LA        - PIANO_KEY_FIRST] = 10u,
+    [MEGADUCK_KEY_PIANO_LA_SHARP  - PIANO_KEY_FIRST] = 11u,
+    [MEGADUCK_KEY_PIANO_SI        - PIANO_KEY_FIRST] = 12u,
+    [MEGADUCK_KEY_PIANO_DO_2        - PIANO_KEY_FIRST] = 13u,
+    [MEGADUCK_KEY_PIANO_DO_2_SHARP  - PIANO_KEY_FIRST] = 14u,
+    [MEGADUCK_KEY_PIANO_RE_2        - PIANO_KEY_FIRST] = 15u,
+    [MEGADUCK_KEY_PIANO_RE_2_SHARP  - PIANO_KEY_FIRST] = 16u,
+    [MEGADUCK_KEY_PIANO_MI_2        - PIANO_KEY_FIRST] = 17u,
+    [MEGADUCK_KEY_PIANO_FA_2        - PIANO_KEY_FIRST] = 18u,
+    [MEGADUCK_KEY_PIANO_FA_2_SHARP  - PIANO_KEY_FIRST] = 19u,
+    [MEGADUCK_KEY_PIANO_SOL_2       - PIANO_KEY_FIRST] = 20u,
+    [MEGADUCK_KEY_PIANO_SOL_2_SHARP - PIANO_KEY_FIRST] = 21u,
+    [MEGADUCK_KEY_PIANO_LA_2        - PIANO_KEY_FIRST] = 22u,
+    [MEGADUCK_KEY_PIANO_LA_2_SHARP  - PIANO_KEY_FIRST] = 23u,
+    [MEGADUCK_KEY_PIANO_SI_2        - PIANO_KEY_FIRST] = 24u,
+};
+
+// Channel period values (2048 - 131072 / Hz), equal temperament with A4 = 440 Hz
+static const uint16_t piano_period[(MEGADUCK_PIANO_OCTAVE_MAX * 12u) + MEGADUCK_PIANO_NOTES] = {
+    1046u, 1102u, 1155u, 1205u, 1253u, 1297u, 1339u, 1379u, 1417u, 1452u, 1486u, 1517u,  // C3 - B3
+    1547u, 1575u, 1602u, 1627u, 1650u, 1673u, 1694u, 1714u, 1732u, 1750u, 1767u, 1783u,  // C4 - B4
+    1798u, 1812u, 1825u, 1837u, 1849u, 1860u, 1871u, 1881u, 1890u, 1899u, 1907u, 1915u,  // C5 - B5
+    1923u, 1930u, 1936u, 1943u, 1949u, 1954u, 1959u, 1964u, 1969u, 1974u, 1978u, 1982u,  // C6 - B6
+};
+
+// Two cycles of a triangle wave, so the Wave channel (32 samples per
+// period) sounds at the same pitch as the Pulse channels for a given period
+static const uint8_t piano_wave[16] = {
+    0x8Au, 0xCEu, 0xFEu, 0xCAu, 0x86u, 0x42u, 0x02u, 0x46u,
+    0x8Au, 0xCEu, 0xFEu, 0xCAu, 0x86u, 0x42u, 0x02u, 0x46u,
+};
+
+uint8_t megaduck_piano_octave = 1u;
+
+static uint8_t piano_voice_note[MEGADUCK_PIANO_VOICES];
+static uint8_t piano_voice_stamp[MEGADUCK_PIANO_VOICES];  // piano_stamp when the voice last started or stopped
+static uint8_t piano_stamp;
+
+
+// Sets up the APU for the piano voices, all voices start silent
+void megaduck_piano_init(void) {
+
+    NR52_REG = 0x80u;  // Sound on
+    NR50_REG = 0x77u;  // Full volume on both outputs
+    NR51_REG = 0xFFu;  // All channels on both outputs
+
+    NR10_REG = 0x00u;  // No sweep
+    NR11_REG = PIANO_DUTY_25;
+    NR21_REG = PIANO_DUTY_25;
+
+    // Wave RAM can only be loaded with the Wave channel DAC off
+    NR30_REG = 0x00u;
+    for (uint8_t c = 0u; c < sizeof(piano_wave); c++)
+        AUD3WAVE[c] = piano_wave[c];
+    NR32_REG = PIANO_WAVE_VOL_100;
+
+    megaduck_piano_all_off();
+}
+
+
+// Returns the note (0 = DO .. 23 = SI_2) for a scan code,
+// or MEGADUCK_PIANO_NO_NOTE if it isn't a piano key
+uint8_t megaduck_piano_note_from_key(uint8_t key_code) {
+
+    uint8_t index = key_code - PIANO_KEY_FIRST;
+
+    if (index >= PIANO_KEY_COUNT) return MEGADUCK_PIANO_NO_NOTE;
+    return piano_note_by_key[index] - 1u;  // 0 (not a piano key) wraps to MEGADUCK_PIANO_NO_NOTE
+}
+
+
+// Starts a voice playing the given period with a trigger
+static void piano_voice_start(uint8_t voice, uint16_t period) {
+
+    switch (voice) {
+        case PIANO_VOICE_PULSE_1:
+            NR12_REG = PIANO_ENVELOPE;
+            NR13_REG = (uint8_t)period;
+            NR14_REG = PIANO_TRIGGER | (uint8_t)(period >> 8);
+            break;
+
+        case PIANO_VOICE_PULSE_2:
+            NR22_REG = PIANO_ENVELOPE;
+            NR23_REG = (uint8_t)period;
+            NR24_REG = PIANO_TRIGGER | (uint8_t)(period >> 8);
+            break;
+
+        default:
+            NR30_REG = PIANO_WAVE_DAC_ON;
+            NR33_REG = (uint8_t)period;
+            NR34_REG = PIANO_TRIGGER | (uint8_t)(period >> 8);
+            break;
+    }
+}
+
+
+// Silences a voice by turning off its channel DAC (no trigger needed)
+static void piano_voice_stop(uint8_t voice) {
+
+    switch (voice) {
+        case PIANO_VOICE_PULSE_1: NR12_REG = PIANO_ENVELOPE_OFF; break;
+        case PIANO_VOICE_PULSE_2: NR22_REG = PIANO_ENVELOPE_OFF; break;
+        default:                  NR30_REG = 0x00u;              break;
+    }
+    piano_voice_note[voice]  = MEGADUCK_PIANO_NO_NOTE;
+    piano_voice_stamp[voice] = piano_stamp++;
+}
+
+
+// Picks a voice for a new note
+//
+// - The voice already playing the note if there is one (it gets retriggered)
+// - Otherwise the voice that has been free the longest,
+//   or if none are free the one playing the oldest note
+static uint8_t piano_voice_pick(uint8_t note) {
+
+    uint8_t pick      = 0u;
+    uint8_t pick_age  = 0u;
+    bool    pick_free = false;
+
+    for (uint8_t voice = 0u; voice < MEGADUCK_PIANO_VOICES; voice++) {
+
+        if (piano_voice_note[voice] == note) return voice;
+
+        bool    is_free = (piano_voice_note[voice] == MEGADUCK_PIANO_NO_NOTE);
+        uint8_t age     = piano_stamp - piano_voice_stamp[voice];
+
+        if ((is_free && !pick_free) || ((is_free == pick_free) && (age > pick_age))) {
+            pick      = voice;
+            pick_age  = age;
+            pick_free = is_free;
+        }
+    }
+    return pick;
+}
+
+
+// Starts a note (0 = DO .. 23 = SI_2) at the current octave
+void megaduck_piano_note_on(uint8_t note) {
+
+    if (note >= MEGADUCK_PIANO_NOTES) return;
+
+    uint8_t voice  = piano_voice_pick(note);
+    uint8_t octave = megaduck_piano_octave;
+
+    // It's a plain variable, so keep the table lookup in range here
+    if (octave > MEGADUCK_PIANO_OCTAVE_MAX) octave = MEGADUCK_PIANO_OCTAVE_MAX;
+
+    piano_voice_start(voice, piano_period[(octave * 12u) + note]);
+    piano_voice_note[voice]  = note;
+    piano_voice_stamp[voice] = piano_stamp++;
+}
+
+
+// Stops a note if it's playing
+void megaduck_piano_note_off(uint8_t note) {
+
+    for (uint8_t voice = 0u; voice < MEGADUCK_PIANO_VOICES; voice++) {
+        if (piano_voice_note[voice] == note) {
+            piano_voice_stop(voice);
+            return;
+        }
+    }
+}
+
+
+// Stops all voices
+void megaduck_piano_all_off(void) {
+
+    for (uint8_t voice = 0u; voice < MEGADUCK_PIANO_VOICES; voice++)
+        piano_voice_stop(voice);
+}
+
+
+// Plays or stops a note for a keyboard event
+//
+// Call it for each event from megaduck_keyboard_get_event() right after
+// the keyboard poll finishes, that keeps scan code to sound latency
+// within the poll interval
+//
+// Returns true if the event was for a piano key
+bool megaduck_piano_key_event(const megaduck_key_event_t * p_event) {
+
+    uint8_t note = megaduck_piano_note_from_key(p_event->key_code);
+
+    if (note == MEGADUCK_PIANO_NO_NOTE) return false;
+
+    if (p_event->edge == KEY_EVENT_PRESS)
+        megaduck_piano_note_on(note);
+    else if (p_event->edge == KEY_EVENT_RELEASE)
+        megaduck_piano_note_off(note);
+    // Hardware repeats while the key stays down need nothing, the note keeps playing
+
+    return true;
+}
@@ -0,0 +1,38 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "megaduck_keyboard.h"
+
+#ifndef _MEGADUCK_PIANO_H
+#define _MEGADUCK_PIANO_H
+
+// Plays the laptop's piano keys (MEGADUCK_KEY_PIANO_*) on the APU
+//
+// - Scan codes go through a lookup table to a note, and the note through
+//   a precomputed period table straight to the channel registers, so a
+//   key sounds in the same main loop pass its keyboard reply arrives in
+// - Three voices: Pulse 1, Pulse 2 and Wave. A new note takes the voice
+//   that has been free the longest, or steals the oldest one if all are busy
+// - The wave pattern holds two cycles, so the Wave channel plays the
+//   same pitch as the Pulse channels from the same period value
+// - The keyboard reports one key at a time, so playing from it uses one
+//   voice at a time. megaduck_piano_note_on() / _off() can play chords
+
+#define MEGADUCK_PIANO_VOICES       3u     // Pulse 1, Pulse 2, Wave
+#define MEGADUCK_PIANO_NOTES        24u    // DO .. SI_2, two octaves of keys
+#define MEGADUCK_PIANO_OCTAVE_MAX   2u     // megaduck_piano_octave: 0 = DO is C3, 1 = C4, 2 = C5
+#define MEGADUCK_PIANO_NO_NOTE      0xFFu
+
+// Octave of the lowest piano key (DO), applies to notes started afterward
+// (values above MEGADUCK_PIANO_OCTAVE_MAX play at the top octave)
+extern uint8_t megaduck_piano_octave;
+
+void    megaduck_piano_init(void);
+uint8_t megaduck_piano_note_from_key(uint8_t key_code);
+void    megaduck_piano_note_on(uint8_t note);
+void    megaduck_piano_note_off(uint8_t note);
+void    megaduck_piano_all_off(void);
+bool    megaduck_piano_key_event(const megaduck_key_event_t * p_event);
+
+#endif // _MEGADUCK_PIANO_H
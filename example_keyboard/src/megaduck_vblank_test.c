@@ -0,0 +1,68 @@
+#include <gbdk/platform.h>
+#include <gbdk/console.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_tick.h>
+
+#include "megaduck_keyboard.h"
+#include "megaduck_vblank_test.h"
+
+#ifdef MEGADUCK_VBLANK_TEST
+
+// One frame is 17556 M-cycles, ~68.6 ticks
+#define MCYCLES_PER_FRAME  17556u
+
+#define POLL_SPACING_TICKS (MEGADUCK_TICKS_FROM_MSEC(20u))
+
+
+void megaduck_vblank_test_run(void) {
+    uint16_t tick_last, vbl_last;
+    uint32_t mcycles    = 0u;   // Not yet counted as whole frames
+    uint16_t frames     = 0u;
+    uint16_t vblanks    = 0u;
+    uint16_t polls_ok   = 0u;
+    uint16_t polls      = 0u;
+
+    printf("VBlank test\n");
+
+    // Start on a frame boundary so the two counts line up
+    vsync();
+    CRITICAL {
+        tick_last = megaduck_tick_now_isr();
+        vbl_last  = sys_time;
+    }
+
+    while (1) {
+        for (uint8_t c = 0u; c < MEGADUCK_VBLANK_TEST_POLLS; c++) {
+            if (megaduck_keyboard_poll_keys()) polls_ok++;
+            polls++;
+            megaduck_tick_wait(POLL_SPACING_TICKS);
+        }
+
+        // Both counts run continuously (printing included), so
+        // they only drift apart when a VBlank gets missed
+        uint16_t tick_now, vbl_now;
+        CRITICAL {
+            tick_now = megaduck_tick_now_isr();
+            vbl_now  = sys_time;
+        }
+        mcycles  += (uint32_t)(uint16_t)(tick_now - tick_last) * MEGADUCK_TICK_MCYCLES;
+        frames   += (uint16_t)(mcycles / MCYCLES_PER_FRAME);
+        mcycles  %= MCYCLES_PER_FRAME;
+        vblanks  += (uint16_t)(vbl_now - vbl_last);
+        tick_last = tick_now;
+        vbl_last  = vbl_now;
+
+        gotoxy(0u, 2u);
+        printf("Polls  %u/%u  \n", polls_ok, polls);
+        printf("Frames %u  \n", frames);
+        printf("VBlank %u  \n", vblanks);
+        // A frame still in progress can show as one extra VBlank, never as a missed one
+        printf("Missed %u  \n", (vblanks < frames) ? (frames - vblanks) : 0u);
+    }
+}
+
+#endif // MEGADUCK_VBLANK_TEST
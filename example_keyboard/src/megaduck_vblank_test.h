@@ -0,0 +1,22 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+
+#ifndef _MEGADUCK_VBLANK_TEST_H
+#define _MEGADUCK_VBLANK_TEST_H
+
+// Missed VBlank test mode, only built with MEGADUCK_VBLANK_TEST defined (VBLANK_TEST=1)
+//
+// Runs blocking keyboard polls back to back (one every 20 msec) and compares
+// the VBlank interrupts seen (sys_time) against the frames that elapsed by
+// the TIMA tick time base. Any difference is a VBlank the serial code blocked
+//
+// - Prints running totals every MEGADUCK_VBLANK_TEST_POLLS polls, never returns
+// - Works without the laptop too, then every poll runs into its timeout
+
+#define MEGADUCK_VBLANK_TEST_POLLS  50u
+
+#ifdef MEGADUCK_VBLANK_TEST
+void megaduck_vblank_test_run(void);
+#endif
+
+#endif // _MEGADUCK_VBLANK_TEST_H
@@ -7,72 +7,99 @@
 #include <stdio.h>
 
 #include <megaduck_laptop_io.h>
+#include <megaduck_link_sched.h>
+#include <megaduck_link_overlay.h>
+#include <megaduck_link_trace.h>
 #include <megaduck_model.h>
 
 #include "megaduck_rtc.h"
+#include "megaduck_rtc_service.h"
+#include "megaduck_display.h"
 
 bool megaduck_laptop_detected = false;
 
-bool rtc_read_ok;
-bool logging_enabled = false;
+uint8_t rtc_status;
+uint8_t rtc_sec_shown = 0xFFu;
+uint8_t rtc_failed_reads_seen = 0u;
+bool overlay_enabled = false;
 
-static void log_rtc_data(void);
-static void log_rtc_data(void);
+// The time is kept locally after the first read,
+// the RTC is only read again every 10 minutes to correct drift
+#define RTC_RESYNC_SECS (10u * 60u)
+
+// Display fields for the date and time
+uint8_t field_year, field_mon, field_day, field_dow;
+uint8_t field_hour, field_min, field_sec, field_ampm;
+
+static void show_rtc_init(void);
+static void use_rtc_data(void);
 static void main_init(void);
 
 
 
 static void main_init(void) {
 
+    // Start the laptop init first, it runs in the background
+    // while the rest of the setup happens
+    megaduck_laptop_init_begin();
+
     SPRITES_8x8;
     SHOW_SPRITES;
     SHOW_BKG;
     printf("Initializing..\n");
 
-    megaduck_laptop_detected = megaduck_laptop_init();
+    while (megaduck_laptop_init_status() == MEGADUCK_LAPTOP_INIT_PENDING)
+        vsync();
+    megaduck_laptop_detected = (megaduck_laptop_init_status() == MEGADUCK_LAPTOP_INIT_OK);
 }
 
 
-// If requested, log some data about the incoming keyboard packet
-static void log_rtc_data(void) {
-
-    gotoxy(0,14);
-    printf("*%hx %hx %hx %hx - %hx %hx %hx %hx\n",
-        (uint8_t)megaduck_rtc_year,
-        (uint8_t)megaduck_rtc_mon,
-        (uint8_t)megaduck_rtc_day,
-        (uint8_t)megaduck_rtc_weekday,
+// Draws the labels once and sets up a display field for each value
+static void show_rtc_init(void) {
 
-        (uint8_t)megaduck_rtc_ampm,
-        (uint8_t)megaduck_rtc_hour,
-        (uint8_t)megaduck_rtc_min,
-        (uint8_t)megaduck_rtc_sec);
+    gotoxy(0,6);
+    printf("Year:\n"
+           "Month:\n"
+           "Day:\n"
+           "DoW:\n"
+           "Time:    :  :\n");
+
+    megaduck_display_init();
+    field_year = megaduck_display_add_field(7u,  6u, 4u);
+    field_mon  = megaduck_display_add_field(7u,  7u, 2u);
+    field_day  = megaduck_display_add_field(7u,  8u, 2u);
+    field_dow  = megaduck_display_add_field(7u,  9u, 9u);
+    field_hour = megaduck_display_add_field(7u,  10u, 2u);
+    field_min  = megaduck_display_add_field(10u, 10u, 2u);
+    field_sec  = megaduck_display_add_field(13u, 10u, 2u);
+    field_ampm = megaduck_display_add_field(16u, 10u, 2u);
 }
 
 
-
 // Example of displaying RTC date info
+//
+// The BCD values from the RTC are drawn as digit tiles directly,
+// and only tiles that changed since the last call get written
+// (during VBlank), so usually just the seconds digit
 static void use_rtc_data(void) {
 
     const char * ampm_str[] = {"am", "pm"};
     const char * dow_str[]  = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+    uint8_t year_bcd[2];
 
-    gotoxy(0,6);
+    // Same 1992 wraparound as megaduck_rtc_get_year()
+    year_bcd[0] = (megaduck_rtc.year >= 0x92u) ? 0x19u : 0x20u;
+    year_bcd[1] = megaduck_rtc.year;
+    megaduck_display_set_bcd(field_year, year_bcd);
+
+    megaduck_display_set_bcd(field_mon, &megaduck_rtc.mon);
+    megaduck_display_set_bcd(field_day, &megaduck_rtc.day);
+    megaduck_display_set_text(field_dow, dow_str[megaduck_rtc.weekday]);  // 0 - 6 is the same in BCD
 
-    printf("Year:  %d  \n"
-           "Month: %d  \n"
-           "Day:   %d  \n"
-           "DoW:   %s  \n"
-           "Time:  %d:%d:%d %s   \n",
-        (uint16_t)megaduck_rtc_year,
-        (uint16_t)megaduck_rtc_mon,
-        (uint16_t)megaduck_rtc_day,
-        (uint16_t)dow_str[megaduck_rtc_weekday],
-
-        (uint16_t)megaduck_rtc_hour,
-        (uint16_t)megaduck_rtc_min,
-        (uint16_t)megaduck_rtc_sec,
-        ampm_str[megaduck_rtc_ampm] );
+    megaduck_display_set_bcd(field_hour, &megaduck_rtc.hour);
+    megaduck_display_set_bcd(field_min,  &megaduck_rtc.min);
+    megaduck_display_set_bcd(field_sec,  &megaduck_rtc.sec);
+    megaduck_display_set_text(field_ampm, ampm_str[megaduck_rtc.ampm]);
 }
 
 
@@ -97,43 +124,64 @@ void main(void) {
 
         printf("\n*SELECT to Set Time\n to Sys rom default");
 
+        show_rtc_init();
+
+        megaduck_sched_init();
+        megaduck_rtc_service_init(RTC_RESYNC_SECS);
+
 		while(1) {
 		    vsync();
-            gamepad = joypad();
 
-            logging_enabled = (gamepad & (J_A | J_B | J_START));
+            #ifdef MEGADUCK_LINK_STATS
+                // One row per frame while still in VBlank
+                if (overlay_enabled)
+                    megaduck_link_overlay_update();
+            #endif
 
-		    // Poll for RTC every other frame
-		    // (Polling intervals below 20ms may cause keyboard lockup)
-		    if (sys_time & 0x01u) {
+            gamepad = joypad();
 
-                // Send RTC data to device if SELECT is pressed
-                // otherwise Read RTC data
-                if (gamepad & J_SELECT) {
-                    bool rtc_send_ok = megaduck_send_rtc();
-                    gotoxy(0,12);
+            // Shows link statistics when START is pressed (when built with MEGADUCK_LINK_STATS)
+            if ((gamepad & J_START) && !(gamepad_last & J_START)) {
+                overlay_enabled = !overlay_enabled;
+                #ifdef MEGADUCK_LINK_STATS
+                    megaduck_link_overlay_show(overlay_enabled);
+                #endif
+            }
+
+            // Send RTC data to device when SELECT is pressed
+            if ((gamepad & J_SELECT) && !(gamepad_last & J_SELECT))
+                megaduck_schedule_send_rtc();
+            gamepad_last = gamepad;
+
+		    // Run serial transactions in the background and advance the local clock
+		    megaduck_sched_update();
+		    megaduck_rtc_service_update();
+
+		    // Reading the time is just a RAM read, only redraw when the seconds change
+		    if (megaduck_rtc_service_synced() && (megaduck_rtc.sec != rtc_sec_shown)) {
+		        rtc_sec_shown = megaduck_rtc.sec;
+		        use_rtc_data();
+		    }
 
-                    if (rtc_send_ok) {
-                        printf("Send RTC: Success");
-                    } else {
-                        printf("Send RTC: Failed!");
-                    }
+		    rtc_status = megaduck_get_scheduled_send_rtc();
+		    if (rtc_status != SERIAL_IO_STATUS_IDLE) {
+                gotoxy(0,12);
 
-                    waitpadup();
+                if (rtc_status == SERIAL_IO_STATUS_DONE) {
+                    printf("Send RTC: Success");
+                    megaduck_rtc_service_resync();
+                } else {
+                    printf("Send RTC: Failed!");
                 }
-                else {
-		            bool rtc_read_ok = megaduck_poll_rtc();
-
-		                if (logging_enabled)
-		                    log_rtc_data();
-
-		            if (rtc_read_ok) {
-		                megaduck_keyboard_process_rtc();
+		    }
 
-		                use_rtc_data();
-                    }
-		        }
+            #ifdef MEGADUCK_LINK_TRACE
+		    // Save the link traffic leading up to a failed read or set, SRAM keeps the latest one
+		    if ((rtc_status == SERIAL_IO_STATUS_FAILED) || (megaduck_rtc_service_failed_reads != rtc_failed_reads_seen)) {
+		        rtc_failed_reads_seen = megaduck_rtc_service_failed_reads;
+		        megaduck_link_trace_flush();
 		    }
+            #endif
 		}
 	}
 }
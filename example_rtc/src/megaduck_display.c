@@ -0,0 +1,176 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "megaduck_display.h"
+
+
+#define DISPLAY_BG_MAP        ((uint8_t *)0x9800u)
+#define DISPLAY_BG_MAP_WIDTH  32u
+
+#define DISPLAY_QUEUE_MASK    (MEGADUCK_DISPLAY_QUEUE_LEN - 1u)
+
+// Last rendered tiles of a field
+//
+// Shadow starts out as DISPLAY_TILE_INVALID (0xFF, blank in the font) so the first set draws everything
+#define DISPLAY_TILE_INVALID  0xFFu
+
+typedef struct display_field_t {
+    uint8_t * p_map;
+    uint8_t  len;
+    uint8_t  shadow[MEGADUCK_DISPLAY_FIELD_LEN_MAX];
+} display_field_t;
+
+typedef struct display_write_t {
+    uint8_t * p_map;
+    uint8_t   tile;
+} display_write_t;
+
+static display_field_t display_fields[MEGADUCK_DISPLAY_FIELDS_MAX];
+static uint8_t         display_field_count;
+
+// Filled by the main loop, emptied by the VBlank interrupt
+static display_write_t  display_queue[MEGADUCK_DISPLAY_QUEUE_LEN];
+static volatile uint8_t display_queue_head;
+static volatile uint8_t display_queue_tail;
+
+static bool display_vbl_added = false;
+
+
+static void megaduck_display_vbl_isr(void);
+
+
+// Writes queued tiles, VRAM is accessible for the whole VBlank period
+static void megaduck_display_vbl_isr(void) {
+
+    uint8_t count = MEGADUCK_DISPLAY_FLUSH_MAX;
+
+    while ((display_queue_head != display_queue_tail) && count--) {
+        display_write_t * p_write = &display_queue[display_queue_head & DISPLAY_QUEUE_MASK];
+        set_vram_byte(p_write->p_map, p_write->tile);
+        display_queue_head++;
+    }
+}
+
+
+// Clears all fields and starts flushing tile writes during VBlank
+//
+// - Safe to call more than once
+void megaduck_display_init(void) {
+
+    CRITICAL {
+        display_field_count = 0u;
+        display_queue_head  = display_queue_tail;
+
+        if (!display_vbl_added) {
+            add_VBL(megaduck_display_vbl_isr);
+            display_vbl_added = true;
+        }
+    }
+}
+
+
+// Adds a field of len tiles starting at BG map tile x,y
+//
+// Returns the field id for megaduck_display_set_*(),
+// or MEGADUCK_DISPLAY_FIELD_NONE if there's no room
+uint8_t megaduck_display_add_field(uint8_t x, uint8_t y, uint8_t len) {
+
+    display_field_t * p_field;
+
+    if ((display_field_count >= MEGADUCK_DISPLAY_FIELDS_MAX) || (len > MEGADUCK_DISPLAY_FIELD_LEN_MAX))
+        return MEGADUCK_DISPLAY_FIELD_NONE;
+
+    p_field = &display_fields[display_field_count];
+    p_field->p_map = DISPLAY_BG_MAP + ((uint16_t)y * DISPLAY_BG_MAP_WIDTH) + x;
+    p_field->len   = len;
+    for (uint8_t c = 0u; c < len; c++)
+        p_field->shadow[c] = DISPLAY_TILE_INVALID;
+
+    return display_field_count++;
+}
+
+
+// Queues a tile write
+//
+// - A tile that's still queued gets its entry updated in place, so the
+//   queue holds at most one write per tile and the last one wins
+// - If the queue is full it waits for VBlank to make room (main loop only).
+//   Writing around the queue would get overwritten by the older queued entry
+static void megaduck_display_queue_tile(uint8_t * p_map, uint8_t tile) {
+
+    bool queued = false;
+
+    // The VBlank interrupt can't take an entry while it's being updated
+    CRITICAL {
+        for (uint8_t idx = display_queue_head; (idx != display_queue_tail) && !queued; idx++) {
+            display_write_t * p_write = &display_queue[idx & DISPLAY_QUEUE_MASK];
+            if (p_write->p_map == p_map) {
+                p_write->tile = tile;
+                queued = true;
+            }
+        }
+    }
+    if (queued) return;
+
+    while ((uint8_t)(display_queue_tail - display_queue_head) >= MEGADUCK_DISPLAY_QUEUE_LEN)
+        vsync();
+
+    display_write_t * p_write = &display_queue[display_queue_tail & DISPLAY_QUEUE_MASK];
+    p_write->p_map = p_map;
+    p_write->tile  = tile;
+    display_queue_tail++;  // Only published once the entry is complete
+}
+
+
+// Sets the tiles of a field (len tiles), only the changed ones get written
+void megaduck_display_set_tiles(uint8_t field, const uint8_t * p_tiles) {
+
+    display_field_t * p_field = &display_fields[field];
+
+    for (uint8_t c = 0u; c < p_field->len; c++) {
+        if (p_field->shadow[c] != p_tiles[c]) {
+            p_field->shadow[c] = p_tiles[c];
+            megaduck_display_queue_tile(p_field->p_map + c, p_tiles[c]);
+        }
+    }
+}
+
+
+// Sets the text of a field, padded with spaces to the field length
+void megaduck_display_set_text(uint8_t field, const char * p_str) {
+
+    uint8_t tiles[MEGADUCK_DISPLAY_FIELD_LEN_MAX];
+    uint8_t len = display_fields[field].len;
+
+    for (uint8_t c = 0u; c < len; c++) {
+        tiles[c] = MEGADUCK_DISPLAY_TILE_FROM_CHAR((*p_str) ? *p_str++ : ' ');
+    }
+    megaduck_display_set_tiles(field, tiles);
+}
+
+
+// Sets a field from BCD values, 2 digits per byte (len / 2 bytes)
+//
+// Each nibble maps straight to a digit tile, so RTC data can be drawn
+// without converting it to binary and back to decimal text
+void megaduck_display_set_bcd(uint8_t field, const uint8_t * p_bcd) {
+
+    uint8_t tiles[MEGADUCK_DISPLAY_FIELD_LEN_MAX];
+    uint8_t len = display_fields[field].len;
+
+    for (uint8_t c = 0u; c < len; c += 2u) {
+        tiles[c]      = MEGADUCK_DISPLAY_TILE_DIGIT_0 + (*p_bcd >> 4);
+        tiles[c + 1u] = MEGADUCK_DISPLAY_TILE_DIGIT_0 + (*p_bcd++ & 0x0Fu);
+    }
+    megaduck_display_set_tiles(field, tiles);
+}
+
+
+// Redraws every field on its next set (ex: after the screen was cleared)
+void megaduck_display_invalidate(void) {
+
+    for (uint8_t field = 0u; field < display_field_count; field++)
+        for (uint8_t c = 0u; c < display_fields[field].len; c++)
+            display_fields[field].shadow[c] = DISPLAY_TILE_INVALID;
+}
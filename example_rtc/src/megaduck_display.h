@@ -0,0 +1,37 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef _MEGADUCK_DISPLAY_H
+#define _MEGADUCK_DISPLAY_H
+
+// Status display with dirty tile tracking
+//
+// Each field is a run of tiles on one row of the BG map. The last
+// rendered tiles of every field are kept, so setting a field only
+// queues the tiles that changed. The queue is written to VRAM from
+// the VBlank interrupt, when VRAM can be written without waiting
+//
+// - A clock whose seconds digit changed costs one VRAM write
+// - Text uses the GBDK console font, where tile index == character code
+
+#define MEGADUCK_DISPLAY_FIELDS_MAX     8u
+#define MEGADUCK_DISPLAY_FIELD_LEN_MAX  10u
+#define MEGADUCK_DISPLAY_FIELD_NONE     0xFFu
+
+// Pending tile writes, power of 2
+#define MEGADUCK_DISPLAY_QUEUE_LEN      32u
+// Tile writes per VBlank, keeps the interrupt inside the VBlank period
+#define MEGADUCK_DISPLAY_FLUSH_MAX      16u
+
+#define MEGADUCK_DISPLAY_TILE_FROM_CHAR(c)  ((uint8_t)(c))
+#define MEGADUCK_DISPLAY_TILE_DIGIT_0       MEGADUCK_DISPLAY_TILE_FROM_CHAR('0')
+
+void    megaduck_display_init(void);
+uint8_t megaduck_display_add_field(uint8_t x, uint8_t y, uint8_t len);
+void    megaduck_display_set_tiles(uint8_t field, const uint8_t * p_tiles);
+void    megaduck_display_set_text(uint8_t field, const char * p_str);
+void    megaduck_display_set_bcd(uint8_t field, const uint8_t * p_bcd);
+void    megaduck_display_invalidate(void);
+
+#endif // _MEGADUCK_DISPLAY_H
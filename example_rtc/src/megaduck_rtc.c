@@ -3,32 +3,42 @@
 #include <stdbool.h>
 
 #include <megaduck_laptop_io.h>
+#include <megaduck_link_sched.h>
 
 #include "megaduck_rtc.h"
 
-// These BCD conversions are for simplicity, in
-// actual programs for performance it may be
-// optimal to use the Game Boy / GBDK BCD features.
+// BCD conversions without divides (the SM83 has no divide
+// or multiply instructions, so / 10 and % 10 are library calls)
+
+// 0xTU is 16T + U, and decimal is 10T + U, so it's 6T less
 uint8_t bcd_to_u8(uint8_t i)
 {
-    return (i & 0xFu) + ((i >> 4) * 10u);
+    uint8_t tens = i >> 4;
+    return i - ((tens << 2) + (tens << 1));
 }
 
+// Values 0 - 99 only, builds the tens digit one bit at a time
 uint8_t u8_to_bcd(uint8_t i)
 {
-    return (i % 10u) + ((i / 10u) << 4);
+    uint8_t bcd = 0x00u;
+
+    if (i >= 80u) { i -= 80u; bcd  = 0x80u; }
+    if (i >= 40u) { i -= 40u; bcd |= 0x40u; }
+    if (i >= 20u) { i -= 20u; bcd |= 0x20u; }
+    if (i >= 10u) { i -= 10u; bcd |= 0x10u; }
+    return bcd | i;
 }
 
 
-uint16_t megaduck_rtc_year;
-uint8_t  megaduck_rtc_mon;
-uint8_t  megaduck_rtc_day;
-uint8_t  megaduck_rtc_weekday;
+megaduck_rtc_data_t megaduck_rtc;
 
-uint8_t  megaduck_rtc_ampm;
-uint8_t  megaduck_rtc_hour;
-uint8_t  megaduck_rtc_min;
-uint8_t  megaduck_rtc_sec;
+// Tick when the RTC data of the latest scheduled read was sampled
+// (the peripheral answers right after the command, so that's when it started)
+uint16_t megaduck_rtc_sample_tick;
+
+// Results of the latest scheduled RTC read / set
+static uint8_t rtc_sched_status      = SERIAL_IO_STATUS_IDLE;
+static uint8_t rtc_send_sched_status = SERIAL_IO_STATUS_IDLE;
 
 
 // Get RTC command reply (Peripheral -> Duck)
@@ -52,49 +62,44 @@ uint8_t  megaduck_rtc_sec;
 //    [7] = int_to_bcd(tm.tm_min);
 //    [8] = int_to_bcd(tm.tm_sec);
 
-// Power-on defaults for the spanish laptop (oddly don't match system ROM hardcoded defaults)
-void megaduck_laptop_set_default_rtc_values(void) {
-
-        megaduck_rtc_year    = 1993u;
-        megaduck_rtc_mon     = 6u; // June
-        megaduck_rtc_day     = 1u; // 1st
-        megaduck_rtc_weekday = 2u; // Tuesday
+// Date and time sent by megaduck_send_rtc() / megaduck_schedule_send_rtc()
+//
+// - Set it with megaduck_rtc_from_epoch() or by filling in the BCD fields
+// - The weekday doesn't need to be filled in, it's worked out from the date when sent
+//
+// Starts out with the power-on defaults for the spanish laptop (oddly don't match system ROM hardcoded defaults)
+megaduck_rtc_data_t megaduck_rtc_send = {
+    .year    = 0x93u, // 1993
+    .mon     = 0x06u, // June
+    .day     = 0x01u, // 1st
 
-        megaduck_rtc_ampm    = 0u; // AM
-        megaduck_rtc_hour    = 0u;
-        megaduck_rtc_min     = 0u;
-        megaduck_rtc_sec     = 0u;
-}
+    .ampm    = 0x00u, // AM
+    .hour    = 0x00u,
+    .min     = 0x00u,
+    .sec     = 0x00u,
+};
 
-// Send RTC data and handle the response
-//
-// Returns success or failure
-bool megaduck_send_rtc(void) {
+// Fills the send buffer with RTC data for setting the time
+static void megaduck_rtc_load_send_buffer(void) {
 
+    const uint8_t * p_src = (const uint8_t *)&megaduck_rtc_send;
 
-// Rewrite sending to just set all value in buffer and precalc checksum/etc with a wrapper function
-// Then change the actual send code to just a single big loop, ay easier to read
+    megaduck_rtc_send.weekday = megaduck_rtc_calc_weekday(&megaduck_rtc_send);
 
-    // For this example set the power-on defaults for the spanish laptop
-    megaduck_laptop_set_default_rtc_values();
+    // Already in the same BCD layout the laptop expects, so it's a straight copy
+    for (uint8_t c = 0u; c < MEGADUCK_RTC_DATA_LEN; c++)
+        megaduck_serial_tx_buf[c] = p_src[c];
 
-    uint8_t year_to_send;
-    // Calculate as number of years since either 1900 or 2000
-    // Strip year off, handle
-    if (megaduck_rtc_year < 2000u) year_to_send = megaduck_rtc_year - 1900u;
-    else                           year_to_send = megaduck_rtc_year - 2000u;
+    megaduck_serial_tx_buf_len = RTC_SEND_LEN;
+}
 
-    megaduck_serial_tx_buf[0] = u8_to_bcd(year_to_send);
-    megaduck_serial_tx_buf[1] = u8_to_bcd(megaduck_rtc_mon);
-    megaduck_serial_tx_buf[2] = u8_to_bcd(megaduck_rtc_day);
-    megaduck_serial_tx_buf[3] = u8_to_bcd(megaduck_rtc_weekday);
 
-    megaduck_serial_tx_buf[4] = megaduck_rtc_ampm;
-    megaduck_serial_tx_buf[5] = megaduck_rtc_hour;
-    megaduck_serial_tx_buf[6] = megaduck_rtc_min;
-    megaduck_serial_tx_buf[7] = megaduck_rtc_sec;
+// Send RTC data and handle the response
+//
+// Returns success or failure
+bool megaduck_send_rtc(void) {
 
-    megaduck_serial_tx_buf_len = RTC_SEND_LEN;
+    megaduck_rtc_load_send_buffer();
 
     if (serial_io_send_command_and_buffer(SYS_CMD_RTC_SET_DATE_AND_TIME)) {
         return true;
@@ -107,28 +112,119 @@ bool megaduck_send_rtc(void) {
 
 // Request RTC data and handle the response
 //
-// Returns success or failure, raw rtc data in BCD format is loaded into vars
+// Returns success or failure, raw rtc data in BCD format is received
+// straight into megaduck_rtc (which may hold a partial reply if it failed)
+//
+// RTC replies are received with their fixed size, so a successful
+// one always filled all of megaduck_rtc
 bool megaduck_poll_rtc(void) {
+    return serial_io_receive_rtc((uint8_t *)&megaduck_rtc);
+}
+
+
+// Starts an RTC request without waiting for the reply
+//
+// Returns false if a serial transaction is already in progress
+bool megaduck_request_rtc(void) {
+
+    return serial_io_begin_receive_rtc((uint8_t *)&megaduck_rtc);
+}
+
+
+// Checks on a request started with megaduck_request_rtc()
+//
+// Returns:
+// - SERIAL_IO_STATUS_IDLE or SERIAL_IO_STATUS_BUSY: nothing new yet
+// - SERIAL_IO_STATUS_DONE: raw rtc data in BCD format is in megaduck_rtc
+// - SERIAL_IO_STATUS_FAILED: request failed
+uint8_t megaduck_check_rtc(void) {
 
-    if (serial_io_send_command_and_receive_buffer(SYS_CMD_RTC_GET_DATE_AND_TIME)) {
-        if (megaduck_serial_rx_buf_len == RTC_REPLY_LEN) {
-            megaduck_rtc_year     = megaduck_serial_rx_buf[0];
-            megaduck_rtc_mon      = megaduck_serial_rx_buf[1];
-            megaduck_rtc_day      = megaduck_serial_rx_buf[2];
-            megaduck_rtc_weekday  = megaduck_serial_rx_buf[3];
-
-            megaduck_rtc_ampm     = megaduck_serial_rx_buf[4];
-            megaduck_rtc_hour     = megaduck_serial_rx_buf[5];
-            megaduck_rtc_min      = megaduck_serial_rx_buf[6];
-            megaduck_rtc_sec      = megaduck_serial_rx_buf[7];
-            return true;
-        }
+    uint8_t status = serial_io_poll_transaction();
+
+    if ((status == SERIAL_IO_STATUS_IDLE) || (status == SERIAL_IO_STATUS_BUSY))
+        return status;
+
+    return (serial_io_get_transaction_result()) ? SERIAL_IO_STATUS_DONE : SERIAL_IO_STATUS_FAILED;
+}
+
+
+// Link scheduler completion for the RTC read slot
+static void megaduck_rtc_sched_complete(bool ok) {
+
+    if (ok) {
+        megaduck_rtc_sample_tick = megaduck_sched_get_start_tick();
+        rtc_sched_status = SERIAL_IO_STATUS_DONE;
     }
-    return false;
+    else
+        rtc_sched_status = SERIAL_IO_STATUS_FAILED;
+}
+
+
+// Link scheduler completion for the RTC set slot
+static void megaduck_rtc_send_sched_complete(bool ok) {
+    rtc_send_sched_status = (ok) ? SERIAL_IO_STATUS_DONE : SERIAL_IO_STATUS_FAILED;
 }
 
 
-// Translates raw RTC data in BCD format to decimal
+// Has the link scheduler read the RTC every period_frames
+//
+// - megaduck_sched_init() must have been called first
+// - With MEGADUCK_SCHED_ONE_SHOT it only reads when megaduck_trigger_rtc() is called
+// - Replies are received straight into p_dest (ex: &megaduck_rtc)
+// - Also sets up the one-shot slot used by megaduck_schedule_send_rtc()
+void megaduck_schedule_rtc(uint16_t period_frames, megaduck_rtc_data_t * p_dest) {
+
+    rtc_sched_status      = SERIAL_IO_STATUS_IDLE;
+    rtc_send_sched_status = SERIAL_IO_STATUS_IDLE;
+
+    megaduck_sched_add(MEGADUCK_SCHED_SLOT_RTC, SYS_CMD_RTC_GET_DATE_AND_TIME, MEGADUCK_SCHED_RECEIVE,
+                       period_frames, NULL, megaduck_rtc_sched_complete);
+    megaduck_sched_set_rx_buffer(MEGADUCK_SCHED_SLOT_RTC, (uint8_t *)p_dest, RTC_REPLY_PAYLOAD_LEN);
+    megaduck_sched_add(MEGADUCK_SCHED_SLOT_RTC_SET, SYS_CMD_RTC_SET_DATE_AND_TIME, MEGADUCK_SCHED_SEND,
+                       MEGADUCK_SCHED_ONE_SHOT, megaduck_rtc_load_send_buffer, megaduck_rtc_send_sched_complete);
+}
+
+
+// Queues a read of the RTC (for one-shot scheduling)
+void megaduck_trigger_rtc(void) {
+    megaduck_sched_trigger(MEGADUCK_SCHED_SLOT_RTC);
+}
+
+
+// Queues setting the RTC, the send buffer is filled when it starts
+void megaduck_schedule_send_rtc(void) {
+    megaduck_sched_trigger(MEGADUCK_SCHED_SLOT_RTC_SET);
+}
+
+
+// Gets the result of the latest scheduled RTC read
+//
+// Call after megaduck_sched_update(), each result is only returned once
+//
+// Returns:
+// - SERIAL_IO_STATUS_IDLE: no read has finished since the last call
+// - SERIAL_IO_STATUS_DONE: raw rtc data in BCD format is in the megaduck_schedule_rtc() destination
+// - SERIAL_IO_STATUS_FAILED: read failed
+uint8_t megaduck_get_scheduled_rtc(void) {
+
+    uint8_t status = rtc_sched_status;
+
+    rtc_sched_status = SERIAL_IO_STATUS_IDLE;
+    return status;
+}
+
+
+// Gets the result of the latest scheduled RTC set, same as megaduck_get_scheduled_rtc()
+uint8_t megaduck_get_scheduled_send_rtc(void) {
+
+    uint8_t status = rtc_send_sched_status;
+
+    rtc_send_sched_status = SERIAL_IO_STATUS_IDLE;
+    return status;
+}
+
+
+// Decodes the year of megaduck_rtc
 //
 // The 1992 wraparound is optional, but it's how
 // the Super Junior SameDuck emulation does it in order
@@ -136,19 +232,154 @@ bool megaduck_poll_rtc(void) {
 // which defaults to 1993 on startup (so BCD 93 for year)
 // and supports years as early as 1992 (BCD 92) within an
 // 8 bit bcd number (max being 99 years).
-void megaduck_keyboard_process_rtc(void) {
+uint16_t megaduck_rtc_get_year(void) {
+
+    uint8_t year = bcd_to_u8(megaduck_rtc.year);
+
+    if (year >= 92u) return year + 1900u;
+    else             return year + 2000u;
+}
+
+
+// == Calendar math ==
+//
+// Table driven and without divides: years come from 4 year cycle
+// and year offset tables, months from the month offset tables, and
+// splitting epoch seconds into days, hours and minutes is a fixed
+// number of compare and subtract steps (see rtc_split())
+
+#define RTC_YEAR_CYCLES     25u    // 4 year cycles in 1992 - 2091
+#define RTC_DAYS_PER_CYCLE  1461u  // 3 x 365 + 366
+
+// Days from 1992 to the start of each 4 year cycle
+static const uint16_t rtc_cycle_days[RTC_YEAR_CYCLES] = {
+        0u,  1461u,  2922u,  4383u,  5844u,  7305u,  8766u, 10227u, 11688u, 13149u, 14610u, 16071u, 17532u,
+    18993u, 20454u, 21915u, 23376u, 24837u, 26298u, 27759u, 29220u, 30681u, 32142u, 33603u, 35064u,
+};
+
+// Days from the start of a 4 year cycle to each of its years (the first one is the leap year)
+static const uint16_t rtc_year_days[4] = { 0u, 366u, 731u, 1096u };
+
+// Days from the start of a non-leap year to each month
+static const uint16_t rtc_month_days[12] = { 0u, 31u, 59u, 90u, 120u, 151u, 181u, 212u, 243u, 273u, 304u, 334u };
+
+// Same as rtc_month_days, but in days of the week (% 7)
+static const uint8_t rtc_month_weekday[12] = { 0u, 3u, 3u, 6u, 1u, 4u, 6u, 2u, 5u, 0u, 3u, 5u };
+
+
+// Years since 1992 (0 - 99) of a BCD year, same 1992 wraparound as megaduck_rtc_get_year()
+static uint8_t rtc_year_index(uint8_t year_bcd) {
+
+    uint8_t year = bcd_to_u8(year_bcd);
+
+    if (year >= 92u) return year - 92u;
+    else             return year + 8u;
+}
+
+
+// Splits a unit out of *p_rem: returns *p_rem / unit and leaves the
+// remainder in *p_rem, for quotients that fit in "bits" bits
+//
+// One compare and subtract per quotient bit, like u8_to_bcd()
+static uint16_t rtc_split(uint32_t * p_rem, uint32_t unit, uint8_t bits) {
+
+    uint16_t count = 0u;
+    uint16_t bit   = 1u << (bits - 1u);
+
+    unit <<= (bits - 1u);
+    do {
+        if (*p_rem >= unit) { *p_rem -= unit; count |= bit; }
+        unit >>= 1;
+        bit  >>= 1;
+    } while (bit);
+
+    return count;
+}
+
+
+// Works out the day of the week of a date in the 1992 - 2091 range
+//
+// Returns 0 - 6, Sunday = 0 (same in BCD)
+uint8_t megaduck_rtc_calc_weekday(const megaduck_rtc_data_t * p_rtc) {
+
+    uint8_t year = rtc_year_index(p_rtc->year);
+    uint8_t mon  = bcd_to_u8(p_rtc->mon) - 1u;
+
+    // 1992-01-01 was a Wednesday, each year moves it 1 day (365 = 52 weeks + 1)
+    // and each leap day before the year 1 more. At most 164, so no divide needed for % 7
+    uint8_t weekday = 3u + year + ((year + 3u) >> 2) + rtc_month_weekday[mon] + (bcd_to_u8(p_rtc->day) - 1u);
+
+    if (!(year & 0x03u) && (mon >= 2u)) weekday++;  // Past Feb 29th
+
+    if (weekday >= 112u) weekday -= 112u;
+    if (weekday >= 56u)  weekday -= 56u;
+    if (weekday >= 28u)  weekday -= 28u;
+    if (weekday >= 14u)  weekday -= 14u;
+    if (weekday >= 7u)   weekday -= 7u;
+    return weekday;
+}
+
+
+// Converts RTC data (BCD, 12 hour) to epoch seconds
+//
+// The weekday is ignored
+uint32_t megaduck_rtc_to_epoch(const megaduck_rtc_data_t * p_rtc) {
+
+    uint8_t  year = rtc_year_index(p_rtc->year);
+    uint8_t  mon  = bcd_to_u8(p_rtc->mon) - 1u;
+    uint8_t  hour = bcd_to_u8(p_rtc->hour) + ((p_rtc->ampm) ? 12u : 0u);
+    uint16_t days;
+    uint16_t mins;
+
+    days = rtc_cycle_days[year >> 2] + rtc_year_days[year & 0x03u] + rtc_month_days[mon] + (bcd_to_u8(p_rtc->day) - 1u);
+    if (!(year & 0x03u) && (mon >= 2u)) days++;  // Past Feb 29th
+
+    // x 60 is x 64 - x 4
+    mins = ((uint16_t)hour << 6) - ((uint16_t)hour << 2) + bcd_to_u8(p_rtc->min);
+
+    return ((uint32_t)days * MEGADUCK_RTC_SECS_PER_DAY) +
+           ((((uint32_t)mins) << 6) - (((uint32_t)mins) << 2)) + bcd_to_u8(p_rtc->sec);
+}
+
+
+// Converts epoch seconds to RTC data (BCD, 12 hour), including the weekday
+//
+// Values must be below MEGADUCK_RTC_EPOCH_END
+void megaduck_rtc_from_epoch(uint32_t epoch_secs, megaduck_rtc_data_t * p_rtc) {
+
+    uint8_t  cycle, year, mon, mday, hour;
+    uint16_t days;
+
+    // 4 year cycle (< 25), then the day inside it (< 1461) and the year that's in
+    cycle = (uint8_t)rtc_split(&epoch_secs, RTC_DAYS_PER_CYCLE * MEGADUCK_RTC_SECS_PER_DAY, 5u);
+    days  = rtc_split(&epoch_secs, MEGADUCK_RTC_SECS_PER_DAY, 11u);
+    year  = 3u;
+    while (days < rtc_year_days[year]) year--;
+    days -= rtc_year_days[year];
+
+    // Then the month, in the leap year Feb 29th is day 59 and later days are one past the table
+    if ((year == 0u) && (days == (31u + 28u))) {
+        mon  = 1u;
+        mday = 29u;
+    } else {
+        if ((year == 0u) && (days > (31u + 28u))) days--;
+        mon = 11u;
+        while (days < rtc_month_days[mon]) mon--;
+        mday = (uint8_t)(days - rtc_month_days[mon]) + 1u;
+    }
+
+    // Time of day
+    hour = (uint8_t)rtc_split(&epoch_secs, MEGADUCK_RTC_SECS_PER_HOUR, 5u);
 
-    megaduck_rtc_year = bcd_to_u8(megaduck_rtc_year);
-    if (megaduck_rtc_year >= 92) megaduck_rtc_year += 1900u;
-    else                         megaduck_rtc_year += 2000u;
+    p_rtc->ampm = (hour >= 12u) ? 1u : 0u;
+    p_rtc->hour = u8_to_bcd((hour >= 12u) ? (hour - 12u) : hour);
+    p_rtc->min  = u8_to_bcd((uint8_t)rtc_split(&epoch_secs, MEGADUCK_RTC_SECS_PER_MIN, 6u));
+    p_rtc->sec  = u8_to_bcd((uint8_t)epoch_secs);
 
-    megaduck_rtc_mon     = bcd_to_u8(megaduck_rtc_mon);
-    megaduck_rtc_day     = bcd_to_u8(megaduck_rtc_day);
-    megaduck_rtc_mon     = bcd_to_u8(megaduck_rtc_mon);
-    megaduck_rtc_weekday = bcd_to_u8(megaduck_rtc_weekday);
+    year += cycle << 2;
+    p_rtc->year = u8_to_bcd((year >= 8u) ? (year - 8u) : (year + 92u));
+    p_rtc->mon  = u8_to_bcd(mon + 1u);
+    p_rtc->day  = u8_to_bcd(mday);
 
-    megaduck_rtc_ampm = bcd_to_u8(megaduck_rtc_ampm);
-    megaduck_rtc_hour = bcd_to_u8(megaduck_rtc_hour);
-    megaduck_rtc_min = bcd_to_u8(megaduck_rtc_min);
-    megaduck_rtc_sec = bcd_to_u8(megaduck_rtc_sec);
+    p_rtc->weekday = megaduck_rtc_calc_weekday(p_rtc);
 }
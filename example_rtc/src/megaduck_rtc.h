@@ -5,22 +5,74 @@
 #ifndef _MEGADUCK_RTC_H
 #define _MEGADUCK_RTC_H
 
+#define MEGADUCK_RTC_DATA_LEN  8u  // RTC reply payload: year, mon, day, weekday, ampm, hour, min, sec
+
+// RTC data, laid out the same as the RTC reply payload so it
+// can be received straight into it. All values are in BCD format
+//   Ex: Month = December = 12th month = 0x12 (NOT 0x0C)
+//
+// Only decode the fields actually used, with the accessors below
+typedef struct megaduck_rtc_data_t {
+    uint8_t year;     // Years since 1900 (92 - 99) or 2000 (00 - 91)
+    uint8_t mon;      // 1 - 12
+    uint8_t day;      // 1 - 31
+    uint8_t weekday;  // 0 - 6, Sunday = 0
+    uint8_t ampm;     // 0 = am, 1 = pm
+    uint8_t hour;     // 0 - 11
+    uint8_t min;
+    uint8_t sec;
+} megaduck_rtc_data_t;
+
+
+// Epoch seconds: a single count of seconds since 1992-01-01 00:00:00,
+// for comparing, diffing and storing times with plain integer math
+//
+// - Covers the years the laptop supports (1992 - 2091), in which
+//   every 4th year starting with 1992 is a leap year
+// - Add MEGADUCK_RTC_EPOCH_UNIX_OFFSET to get Unix time
+#define MEGADUCK_RTC_EPOCH_YEAR         1992u
+#define MEGADUCK_RTC_EPOCH_END          3155760000UL  // 2092-01-01, first value past the supported range
+#define MEGADUCK_RTC_EPOCH_UNIX_OFFSET  694224000UL   // Seconds from 1970-01-01 to 1992-01-01
+
+#define MEGADUCK_RTC_SECS_PER_MIN   60u
+#define MEGADUCK_RTC_SECS_PER_HOUR  3600u
+#define MEGADUCK_RTC_SECS_PER_DAY   86400UL
+
 
 // RTC data
-extern uint16_t megaduck_rtc_year;
-extern uint8_t  megaduck_rtc_mon;
-extern uint8_t  megaduck_rtc_day;
-extern uint8_t  megaduck_rtc_weekday;
+extern megaduck_rtc_data_t megaduck_rtc;
+extern megaduck_rtc_data_t megaduck_rtc_send;
+extern uint16_t megaduck_rtc_sample_tick;
+
+
+uint8_t bcd_to_u8(uint8_t i);
+uint8_t u8_to_bcd(uint8_t i);
+
+#define megaduck_rtc_get_mon()      bcd_to_u8(megaduck_rtc.mon)
+#define megaduck_rtc_get_day()      bcd_to_u8(megaduck_rtc.day)
+#define megaduck_rtc_get_weekday()  bcd_to_u8(megaduck_rtc.weekday)
+#define megaduck_rtc_get_ampm()     (megaduck_rtc.ampm)
+#define megaduck_rtc_get_hour()     bcd_to_u8(megaduck_rtc.hour)
+#define megaduck_rtc_get_hour24()   (megaduck_rtc_get_hour() + ((megaduck_rtc.ampm) ? 12u : 0u))
+#define megaduck_rtc_get_min()      bcd_to_u8(megaduck_rtc.min)
+#define megaduck_rtc_get_sec()      bcd_to_u8(megaduck_rtc.sec)
+uint16_t megaduck_rtc_get_year(void);
 
-extern uint8_t  megaduck_rtc_ampm;
-extern uint8_t  megaduck_rtc_hour;
-extern uint8_t  megaduck_rtc_min;
-extern uint8_t  megaduck_rtc_sec;
+uint8_t  megaduck_rtc_calc_weekday(const megaduck_rtc_data_t * p_rtc);
+uint32_t megaduck_rtc_to_epoch(const megaduck_rtc_data_t * p_rtc);
+void     megaduck_rtc_from_epoch(uint32_t epoch_secs, megaduck_rtc_data_t * p_rtc);
+#define  megaduck_rtc_get_epoch()  megaduck_rtc_to_epoch(&megaduck_rtc)
 
 
-bool megaduck_send_rtc(void);
-bool megaduck_poll_rtc(void);
-void megaduck_keyboard_process_rtc(void);
+bool    megaduck_send_rtc(void);
+bool    megaduck_poll_rtc(void);
+bool    megaduck_request_rtc(void);
+uint8_t megaduck_check_rtc(void);
+void    megaduck_schedule_rtc(uint16_t period_frames, megaduck_rtc_data_t * p_dest);
+void    megaduck_trigger_rtc(void);
+void    megaduck_schedule_send_rtc(void);
+uint8_t megaduck_get_scheduled_rtc(void);
+uint8_t megaduck_get_scheduled_send_rtc(void);
 
 
 #endif // _MEGADUCK_RTC_H
@@ -0,0 +1,243 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_link_sched.h>
+#include <megaduck_tick.h>
+
+#include "megaduck_rtc.h"
+#include "megaduck_rtc_service.h"
+
+
+uint16_t megaduck_rtc_subsec;
+uint16_t megaduck_rtc_service_resync_secs  = MEGADUCK_RTC_RESYNC_DEFAULT_SECS;
+uint8_t  megaduck_rtc_service_state        = MEGADUCK_RTC_SERVICE_UNSYNCED;
+uint8_t  megaduck_rtc_service_failed_reads = 0u;
+
+static uint16_t rtc_service_last_tick;      // Tick of the last local update
+static uint16_t rtc_service_resync_count;   // Seconds until the next resync
+static uint16_t rtc_service_prev_sample;    // Sample tick of the previous read while searching
+static uint8_t  rtc_service_prev_sec;       // Seconds value of the previous read while searching
+static bool     rtc_service_have_prev;
+static bool     rtc_service_locked_once = false;
+
+// Scheduled reads land here so a resync doesn't disturb the running clock
+static megaduck_rtc_data_t rtc_service_read;
+
+// In BCD, for comparing against the BCD day
+static const uint8_t days_in_month[12] = { 0x31u, 0x28u, 0x31u, 0x30u, 0x31u, 0x30u, 0x31u, 0x31u, 0x30u, 0x31u, 0x30u, 0x31u };
+
+
+// Increments a BCD value
+static uint8_t bcd_inc(uint8_t i) {
+
+    i++;
+    if ((i & 0x0Fu) == 0x0Au) i += 0x06u;
+    return i;
+}
+
+
+// Returns the days in a month, all in BCD
+//
+// Years the laptop supports (1992 - 2091) are leap years every 4 years
+static uint8_t megaduck_rtc_service_month_days(uint8_t mon, uint8_t year) {
+
+    if ((mon == 0x02u) && !(bcd_to_u8(year) & 0x03u))
+        return 0x29u;
+    return days_in_month[bcd_to_u8(mon) - 1u];
+}
+
+
+// Returns true if both digits of a BCD value are 0 - 9
+static bool bcd_valid(uint8_t i) {
+    return ((i & 0x0Fu) <= 0x09u) && (i <= 0x99u);
+}
+
+
+// Checks an RTC read before the local clock uses it
+//
+// A corrupt reply that still passed the checksum, or an RTC that was
+// never set, could otherwise index past days_in_month[] later on
+static bool megaduck_rtc_service_sample_valid(const megaduck_rtc_data_t * p_rtc) {
+
+    if (!bcd_valid(p_rtc->year) || !bcd_valid(p_rtc->mon) || !bcd_valid(p_rtc->day) ||
+        !bcd_valid(p_rtc->hour) || !bcd_valid(p_rtc->min) || !bcd_valid(p_rtc->sec))
+        return false;
+
+    // Month first, the day check looks up its length
+    if ((p_rtc->mon == 0x00u) || (p_rtc->mon > 0x12u)) return false;
+
+    return (p_rtc->day != 0x00u) && (p_rtc->day <= megaduck_rtc_service_month_days(p_rtc->mon, p_rtc->year)) &&
+           (p_rtc->weekday < 7u) && (p_rtc->ampm <= 1u) &&
+           (p_rtc->hour <= 0x11u) && (p_rtc->min <= 0x59u) && (p_rtc->sec <= 0x59u);
+}
+
+
+// Advances the date by one day
+static void megaduck_rtc_service_next_day(void) {
+
+    uint8_t month_days = megaduck_rtc_service_month_days(megaduck_rtc.mon, megaduck_rtc.year);
+
+    if (++megaduck_rtc.weekday >= 7u) megaduck_rtc.weekday = 0u;
+
+    megaduck_rtc.day = bcd_inc(megaduck_rtc.day);
+    if (megaduck_rtc.day > month_days) {
+        megaduck_rtc.day = 0x01u;
+        megaduck_rtc.mon = bcd_inc(megaduck_rtc.mon);
+        if (megaduck_rtc.mon > 0x12u) {
+            megaduck_rtc.mon  = 0x01u;
+            megaduck_rtc.year = bcd_inc(megaduck_rtc.year);
+            if (megaduck_rtc.year == 0xA0u) megaduck_rtc.year = 0x00u;  // 1999 -> 2000
+        }
+    }
+}
+
+
+// Advances the time by one second, directly in BCD
+//
+// The RTC keeps 12 hour time (0 - 11) with an am/pm flag
+static void megaduck_rtc_service_next_sec(void) {
+
+    megaduck_rtc.sec = bcd_inc(megaduck_rtc.sec);
+    if (megaduck_rtc.sec < 0x60u) return;
+    megaduck_rtc.sec = 0x00u;
+
+    megaduck_rtc.min = bcd_inc(megaduck_rtc.min);
+    if (megaduck_rtc.min < 0x60u) return;
+    megaduck_rtc.min = 0x00u;
+
+    megaduck_rtc.hour = bcd_inc(megaduck_rtc.hour);
+    if (megaduck_rtc.hour < 0x12u) return;
+    megaduck_rtc.hour = 0x00u;
+
+    megaduck_rtc.ampm ^= 0x01u;
+    if (megaduck_rtc.ampm == 0u)
+        megaduck_rtc_service_next_day();
+}
+
+
+// Starts reading the RTC until its seconds roll over
+static void megaduck_rtc_service_start_search(void) {
+
+    rtc_service_have_prev = false;
+    megaduck_rtc_service_state = MEGADUCK_RTC_SERVICE_SEARCH;
+    megaduck_trigger_rtc();
+}
+
+
+// Handles an RTC read while searching for the seconds rollover
+//
+// The rollover happened somewhere between the previous sample and this one,
+// so the midpoint is used as the start of the second. Until then the reads
+// are only compared, the local clock keeps running if it was already locked
+static void megaduck_rtc_service_handle_read(void) {
+
+    uint16_t now;
+    uint8_t  sec = rtc_service_read.sec;  // BCD is fine for comparing
+
+    // Out of range fields count as a failed read, and searching goes on
+    if (!megaduck_rtc_service_sample_valid(&rtc_service_read)) {
+        megaduck_rtc_service_failed_reads++;
+        megaduck_trigger_rtc();
+        return;
+    }
+
+    if (!rtc_service_have_prev || (sec == rtc_service_prev_sec)) {
+        rtc_service_prev_sec    = sec;
+        rtc_service_prev_sample = megaduck_rtc_sample_tick;
+        rtc_service_have_prev   = true;
+        megaduck_trigger_rtc();
+        return;
+    }
+
+    megaduck_rtc = rtc_service_read;
+
+    now = megaduck_tick_now();
+    megaduck_rtc_subsec = (now - megaduck_rtc_sample_tick) +
+                          ((uint16_t)(megaduck_rtc_sample_tick - rtc_service_prev_sample) >> 1);
+
+    // A slow read (or several failed ones in between) may already be past the next second
+    while (megaduck_rtc_subsec >= MEGADUCK_RTC_SUBSEC_PER_SEC) {
+        megaduck_rtc_subsec -= MEGADUCK_RTC_SUBSEC_PER_SEC;
+        megaduck_rtc_service_next_sec();
+    }
+
+    rtc_service_last_tick      = now;
+    rtc_service_resync_count   = megaduck_rtc_service_resync_secs;
+    rtc_service_locked_once    = true;
+    megaduck_rtc_service_state = MEGADUCK_RTC_SERVICE_LOCKED;
+}
+
+
+// Sets up the RTC read slot and starts the first sync
+//
+// - megaduck_sched_init() must have been called first
+// - resync_secs: how often to resync with the RTC, 0 for never
+void megaduck_rtc_service_init(uint16_t resync_secs) {
+
+    megaduck_rtc_service_resync_secs = resync_secs;
+    megaduck_rtc_subsec     = 0u;
+    rtc_service_locked_once = false;
+
+    megaduck_schedule_rtc(MEGADUCK_SCHED_ONE_SHOT, &rtc_service_read);
+    megaduck_rtc_service_start_search();
+}
+
+
+// Requests a resync as soon as possible (ex: after setting the RTC)
+void megaduck_rtc_service_resync(void) {
+    megaduck_rtc_service_start_search();
+}
+
+
+// Returns true once the local clock has been locked to the RTC
+// (stays true during later resyncs)
+bool megaduck_rtc_service_synced(void) {
+    return rtc_service_locked_once;
+}
+
+
+// Advances the local clock and runs any sync in progress
+//
+// - Call once per frame after megaduck_sched_update()
+// - Must be called at least every few seconds to keep up with the tick counter
+void megaduck_rtc_service_update(void) {
+
+    uint8_t  status = megaduck_get_scheduled_rtc();
+    uint16_t now;
+
+    if (megaduck_rtc_service_state == MEGADUCK_RTC_SERVICE_UNSYNCED)
+        return;
+
+    // Run the clock locally once it has been locked, including during resyncs
+    if (rtc_service_locked_once) {
+        now = megaduck_tick_now();
+        megaduck_rtc_subsec  += (now - rtc_service_last_tick);
+        rtc_service_last_tick = now;
+
+        while (megaduck_rtc_subsec >= MEGADUCK_RTC_SUBSEC_PER_SEC) {
+            megaduck_rtc_subsec -= MEGADUCK_RTC_SUBSEC_PER_SEC;
+            megaduck_rtc_service_next_sec();
+
+            if ((megaduck_rtc_service_state == MEGADUCK_RTC_SERVICE_LOCKED) && rtc_service_resync_count) {
+                if (--rtc_service_resync_count == 0u)
+                    megaduck_rtc_service_state = MEGADUCK_RTC_SERVICE_RESYNC;
+            }
+        }
+    }
+
+    if (megaduck_rtc_service_state == MEGADUCK_RTC_SERVICE_SEARCH) {
+        if (status == SERIAL_IO_STATUS_DONE)
+            megaduck_rtc_service_handle_read();
+        else if (status == SERIAL_IO_STATUS_FAILED) {
+            megaduck_rtc_service_failed_reads++;
+            megaduck_trigger_rtc();
+        }
+    }
+    // Start reading shortly before the rollover is expected,
+    // so only a few reads are needed to catch it
+    else if ((megaduck_rtc_service_state == MEGADUCK_RTC_SERVICE_RESYNC) &&
+             (megaduck_rtc_subsec >= (MEGADUCK_RTC_SUBSEC_PER_SEC - MEGADUCK_RTC_RESYNC_LEAD_TICKS)))
+        megaduck_rtc_service_start_search();
+}
@@ -0,0 +1,49 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <megaduck_tick.h>
+
+#ifndef _MEGADUCK_RTC_SERVICE_H
+#define _MEGADUCK_RTC_SERVICE_H
+
+// Local RTC clock
+//
+// Reads the laptop RTC once, then keeps megaduck_rtc (BCD)
+// running from the tick time base, so reading the time is just
+// a RAM read with no serial traffic
+//
+// - Syncing reads the RTC until its seconds roll over, which locks
+//   megaduck_rtc_subsec to the RTC's own second boundary
+// - Resyncs every megaduck_rtc_service_resync_secs to correct drift
+// - The local clock keeps running during resyncs and is corrected
+//   once the new rollover has been found
+// - Reads with out of range fields (ex: month 0 or 13, or a bad BCD
+//   digit) are skipped, the clock only locks to a valid one
+// - Uses the RTC read slot of the link scheduler, so don't also
+//   call megaduck_get_scheduled_rtc() while it's running
+
+// Sub-second units, same as the tick time base
+#define MEGADUCK_RTC_SUBSEC_PER_SEC   MEGADUCK_TICK_HZ
+
+#define MEGADUCK_RTC_RESYNC_DEFAULT_SECS  (10u * 60u)
+
+// Resyncs start reading this long before the predicted rollover
+#define MEGADUCK_RTC_RESYNC_LEAD_TICKS    MEGADUCK_TICKS_FROM_MSEC(100u)
+
+#define MEGADUCK_RTC_SERVICE_UNSYNCED   0u  // Waiting for the first read
+#define MEGADUCK_RTC_SERVICE_SEARCH     1u  // Reading until the seconds roll over
+#define MEGADUCK_RTC_SERVICE_LOCKED     2u  // Running locally
+#define MEGADUCK_RTC_SERVICE_RESYNC     3u  // Running locally, waiting to start a resync
+
+extern uint16_t megaduck_rtc_subsec;          // Ticks into the current second, 0 .. MEGADUCK_RTC_SUBSEC_PER_SEC - 1
+extern uint16_t megaduck_rtc_service_resync_secs;
+extern uint8_t  megaduck_rtc_service_state;
+extern uint8_t  megaduck_rtc_service_failed_reads;  // Count of failed or invalid RTC reads, wraps around
+
+void megaduck_rtc_service_init(uint16_t resync_secs);
+void megaduck_rtc_service_update(void);
+void megaduck_rtc_service_resync(void);
+bool megaduck_rtc_service_synced(void);
+
+#endif // _MEGADUCK_RTC_SERVICE_H
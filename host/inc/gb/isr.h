@@ -0,0 +1,12 @@
+// Host build stand-in for the GBDK ISR vector header
+//
+// The simulated hardware calls sio_isr() directly
+
+#ifndef _HOST_GB_ISR_H
+#define _HOST_GB_ISR_H
+
+#define VECTOR_SERIAL  0x58u
+
+#define ISR_VECTOR(vector, handler)
+
+#endif // _HOST_GB_ISR_H
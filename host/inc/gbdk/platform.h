@@ -0,0 +1,123 @@
+// Host build stand-in for the GBDK platform header
+//
+// Maps the registers and GBDK calls used by common/ onto the
+// simulated hardware in sim_hw.c
+
+#ifndef _HOST_GBDK_PLATFORM_H
+#define _HOST_GBDK_PLATFORM_H
+
+#include <stddef.h>  // NULL, comes from gbdk/platform.h -> types.h with GBDK
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <sim_hw.h>
+
+// SDCC keywords
+// - Interrupts are only dispatched between register accesses, and only
+//   while IME is on. CRITICAL saves IME, turns it off for the block and
+//   restores it after, so don't leave a CRITICAL block with return or break
+// - On SM83 a critical section ends with an unconditional ei, so entering
+//   one with IME already off is counted in sim_ime_faults
+// - Interrupt handlers are run with IME off, see sim_dispatch()
+#define CRITICAL  for (bool sim_crit_ime = sim_critical_enter(), sim_crit_once = true; \
+                       sim_crit_once; sim_critical_exit(sim_crit_ime), sim_crit_once = false)
+#define CRITICAL_INTERRUPT
+// Every pass of a wait loop that doesn't end the wait is idle, see sim_wait_idle()
+#define MEGADUCK_WAIT_WHILE(cond)  for (uint64_t sim_wait_mark = sim_wait_begin(); \
+                                        (cond); sim_wait_idle(sim_wait_mark))
+#define INTERRUPT
+#define NONBANKED
+#define BANKED
+#define SFR       uint8_t
+#define __at(addr)
+
+// Registers
+#define SB_REG    (*sim_reg(SIM_REG_SB))
+#define SC_REG    (*sim_reg(SIM_REG_SC))
+#define IE_REG    (*sim_reg(SIM_REG_IE))
+#define IF_REG    (*sim_reg(SIM_REG_IF))
+#define FF60_REG  (*sim_reg(SIM_REG_FF60))
+#define DIV_REG   (*sim_reg(SIM_REG_DIV))
+#define TIMA_REG  (*sim_reg(SIM_REG_TIMA))
+#define TMA_REG   (*sim_reg(SIM_REG_TMA))
+#define TAC_REG   (*sim_reg(SIM_REG_TAC))
+#define LY_REG    (*sim_reg(SIM_REG_LY))
+#define STAT_REG  (*sim_reg(SIM_REG_STAT))
+#define LCDC_REG  (*sim_reg(SIM_REG_LCDC))
+#define WY_REG    (*sim_reg(SIM_REG_WY))
+#define WX_REG    (*sim_reg(SIM_REG_WX))
+
+// Audio registers, by their Game Boy address (0xFF10 - 0xFF3F)
+#define NR10_REG  (*sim_audio_reg(0x10u))
+#define NR11_REG  (*sim_audio_reg(0x11u))
+#define NR12_REG  (*sim_audio_reg(0x12u))
+#define NR13_REG  (*sim_audio_reg(0x13u))
+#define NR14_REG  (*sim_audio_reg(0x14u))
+#define NR21_REG  (*sim_audio_reg(0x16u))
+#define NR22_REG  (*sim_audio_reg(0x17u))
+#define NR23_REG  (*sim_audio_reg(0x18u))
+#define NR24_REG  (*sim_audio_reg(0x19u))
+#define NR30_REG  (*sim_audio_reg(0x1Au))
+#define NR31_REG  (*sim_audio_reg(0x1Bu))
+#define NR32_REG  (*sim_audio_reg(0x1Cu))
+#define NR33_REG  (*sim_audio_reg(0x1Du))
+#define NR34_REG  (*sim_audio_reg(0x1Eu))
+#define NR50_REG  (*sim_audio_reg(0x24u))
+#define NR51_REG  (*sim_audio_reg(0x25u))
+#define NR52_REG  (*sim_audio_reg(0x26u))
+#define AUD3WAVE  (&sim_audio_regs[0x30u])
+
+#define VBL_IFLAG 0x01u
+#define LCD_IFLAG 0x02u
+#define TIM_IFLAG 0x04u
+#define SIO_IFLAG 0x08u
+#define JOY_IFLAG 0x10u
+
+#define SIOF_CLOCK_EXT   0x00u
+#define SIOF_CLOCK_INT   0x01u
+#define SIOF_XFER_START  0x80u
+
+#define TACF_START   0x04u
+#define TACF_STOP    0x00u
+#define TACF_4KHZ    0x00u
+#define TACF_262KHZ  0x01u
+#define TACF_65KHZ   0x02u
+#define TACF_16KHZ   0x03u
+
+#define LCDCF_ON       0x80u
+#define LCDCF_WIN9C00  0x40u
+#define LCDCF_WINON    0x20u
+
+#define SHOW_WIN  (LCDC_REG |= LCDCF_WINON)
+#define HIDE_WIN  (LCDC_REG &= ~LCDCF_WINON)
+
+#define DEVICE_SCREEN_PX_HEIGHT     144u
+#define DEVICE_WINDOW_PX_OFFSET_X   7u
+
+extern volatile uint16_t sys_time;
+
+void    enable_interrupts(void);
+void    disable_interrupts(void);
+void    set_interrupts(uint8_t flags);
+void    add_VBL(void (*handler)(void));
+void    vsync(void);
+
+uint8_t get_vram_byte(uint8_t * addr);
+void    set_vram_byte(uint8_t * addr, uint8_t v);
+
+// ROM banks, every banked module is in bank 2 on the host
+#define BANK(name)            ((uint8_t)2u)
+#define BANKREF(name)
+#define BANKREF_EXTERN(name)
+#define CURRENT_BANK          sim_rom_bank
+#define SWITCH_ROM(bank)      sim_switch_rom(bank)
+
+// Cartridge SRAM
+#define ENABLE_RAM   ((void)0)
+#define DISABLE_RAM  ((void)0)
+#define MEGADUCK_LINK_TRACE_SRAM  (sim_sram)
+
+// Unchecked bulk VRAM reads (a plain memcpy() on hardware)
+#define MEGADUCK_VRAM_READ(p_dest, p_vram, len)  sim_vram_read((p_dest), (p_vram), (len))
+
+#endif // _HOST_GBDK_PLATFORM_H
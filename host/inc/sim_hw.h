@@ -0,0 +1,76 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef _SIM_HW_H
+#define _SIM_HW_H
+
+// Simulated hardware for the host build
+//
+// - Registers live in a simulated register block, every access goes
+//   through sim_reg() which also advances the virtual clock, runs the
+//   serial link / timer / VBlank models and dispatches interrupts
+// - Time only passes on register accesses, so wait loops need to
+//   read a register (the tick time base does) to make progress
+// - Separately from the clock, sim_work_cycles estimates the CPU time the
+//   program spends: register accesses plus SIM_MCYCLES_PER_BLOCK for every
+//   basic block run in the library and example modules (built with
+//   -fsanitize-coverage=trace-pc). Passes of a wait loop that don't end
+//   the wait are left out, see MEGADUCK_WAIT_WHILE()
+
+#define SIM_REG_SB      0u
+#define SIM_REG_SC      1u
+#define SIM_REG_IE      2u
+#define SIM_REG_IF      3u
+#define SIM_REG_FF60    4u
+#define SIM_REG_DIV     5u
+#define SIM_REG_TIMA    6u
+#define SIM_REG_TMA     7u
+#define SIM_REG_TAC     8u
+#define SIM_REG_LY      9u
+#define SIM_REG_STAT   10u
+#define SIM_REG_LCDC   11u
+#define SIM_REG_WY     12u
+#define SIM_REG_WX     13u
+#define SIM_REG_COUNT  14u
+
+#define SIM_MCYCLES_PER_REG_ACCESS   3u     // ldh a, (n)
+#define SIM_MCYCLES_PER_LINK_BYTE    1024u  // 8 bits at 8192 Hz
+#define SIM_MCYCLES_PER_SCANLINE     114u
+#define SIM_MCYCLES_PER_FRAME        17556u // 154 scanlines
+#define SIM_MCYCLES_PER_TIMA_4KHZ    256u
+#define SIM_MCYCLES_PER_SEC          1048576u
+#define SIM_MCYCLES_PER_VRAM_COPY    8u     // Per byte, unrolled ld a, (hl+) / ld (de), a / inc de
+#define SIM_MCYCLES_PER_BLOCK        8u     // Rough average for a basic block of SDCC output
+#define SIM_LY_VBLANK_START          144u
+#define SIM_LY_COUNT                 154u
+
+#define SIM_VRAM_BASE  0x8000u
+#define SIM_VRAM_SIZE  0x2000u
+#define SIM_SRAM_SIZE  0x2000u
+
+extern uint64_t sim_cycles;
+extern uint64_t sim_work_cycles;         // Estimated CPU time, without idle waiting
+extern uint8_t  sim_vram[SIM_VRAM_SIZE];
+extern uint8_t  sim_sram[SIM_SRAM_SIZE];  // Cartridge SRAM at 0xA000
+extern uint16_t sim_vram_blocked_reads;  // Unchecked VRAM reads outside VBlank with the LCD on
+extern uint32_t sim_vram_writes;         // set_vram_byte() calls
+extern volatile uint8_t sim_audio_regs[0x40u];  // Audio registers by the low byte of their address
+extern uint32_t sim_audio_accesses;      // Audio register accesses
+extern uint8_t  sim_rom_bank;            // Switchable ROM bank at 0x4000
+extern uint32_t sim_rom_switches;        // SWITCH_ROM() calls
+extern uint16_t sim_ime_faults;          // Interrupts turned on early (CRITICAL entered or
+                                         // enable_interrupts() called with IME meant to be off)
+
+volatile uint8_t * sim_reg(uint8_t reg);
+volatile uint8_t * sim_audio_reg(uint8_t addr);
+void sim_switch_rom(uint8_t bank);
+void sim_hw_reset(void);
+void sim_advance(uint32_t mcycles);
+void sim_advance_to_vblank(void);
+void sim_vram_read(void * p_dest, const void * p_vram, uint16_t len);
+bool sim_critical_enter(void);
+void sim_critical_exit(bool ime);
+uint64_t sim_wait_begin(void);
+void sim_wait_idle(uint64_t mark);
+
+#endif // _SIM_HW_H
@@ -0,0 +1,218 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gbdk/platform.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_keycodes.h>
+#include <megaduck_model.h>
+
+#include "megaduck_key2ascii.h"
+#include "megaduck_keyboard.h"
+#include "megaduck_rtc.h"
+
+#include "sim_peripheral.h"
+
+// Benchmarks the protocol and decode hot paths against the scripted peripheral
+//
+// - Paths are measured in the simulator's estimate of the M-cycles the
+//   CPU spends on them (sim_work_cycles, see sim_hw.h): register accesses
+//   and basic blocks run, without the time spent waiting for the link,
+//   the peripheral's reply or a timeout. The waiting depends on the peer,
+//   and would hide any change to the code itself.
+// - Each is compared against a stored baseline, any path over its
+//   baseline + tolerance fails.
+// - Block counts come from the host compiler's output, so update the
+//   baseline after switching compilers.
+//
+// Usage: megaduck_bench <target> <baseline file> [--update]
+//   target: "megaduck" (laptop present) or "gb" (no laptop can be attached)
+
+#define BENCH_TOLERANCE_PCT   5u
+#define BENCH_KEY_POLLS       8u
+#define BENCH_ASCII_FLAGS     8u  // Repeat, Caps Lock and Shift combinations
+
+#define BENCH_MAX_RESULTS     8u
+#define BENCH_NAME_LEN        40u
+
+typedef struct bench_result_t {
+    char     name[BENCH_NAME_LEN];
+    uint64_t mcycles;
+} bench_result_t;
+
+static bench_result_t bench_results[BENCH_MAX_RESULTS];
+static uint8_t        bench_result_count;
+static bool           bench_laptop_present;
+
+
+static void bench_record(const char * name, uint64_t mcycles) {
+    if (bench_result_count < BENCH_MAX_RESULTS) {
+        snprintf(bench_results[bench_result_count].name, BENCH_NAME_LEN, "%s", name);
+        bench_results[bench_result_count].mcycles = mcycles;
+        bench_result_count++;
+    }
+}
+
+
+static void bench_periph_reset(bool initialized) {
+    sim_hw_reset();
+    sim_periph_reset();
+    megaduck_tick_init();
+    if (!bench_laptop_present) sim_periph.fault = SIM_FAULT_ABSENT;
+    else if (initialized)      sim_periph_force_initialized();
+}
+
+
+static void bench_controller_init(void) {
+    bench_periph_reset(false);
+
+    uint64_t start = sim_work_cycles;
+    megaduck_laptop_init();
+    bench_record("laptop_init", sim_work_cycles - start);
+}
+
+
+static void bench_keyboard(void) {
+    static const uint8_t codes[BENCH_KEY_POLLS] = {
+        MEGADUCK_KEY_A, 0x00u, MEGADUCK_KEY_SPACE, MEGADUCK_KEY_ARROW_UP,
+        MEGADUCK_KEY_1, 0x00u, MEGADUCK_KEY_ENTER, MEGADUCK_KEY_Z };
+
+    bench_periph_reset(true);
+
+    uint64_t start = sim_work_cycles;
+    for (uint8_t c = 0u; c < BENCH_KEY_POLLS; c++) {
+        sim_periph.key_flags = (c & 0x01u) ? MEGADUCK_KEY_FLAG_SHIFT : 0x00u;
+        sim_periph.key_code  = codes[c];
+        if (megaduck_keyboard_poll_keys())
+            megaduck_keyboard_process_keys();
+    }
+    bench_record("keyboard_poll_process", (sim_work_cycles - start) / BENCH_KEY_POLLS);
+}
+
+
+static void bench_rtc(void) {
+    static const uint8_t rtc_bcd[8] = { 0x93u, 0x06u, 0x01u, 0x02u, 0x00u, 0x11u, 0x59u, 0x30u };
+
+    bench_periph_reset(true);
+    memcpy(sim_periph.rtc, rtc_bcd, sizeof(rtc_bcd));
+
+    uint64_t start = sim_work_cycles;
+    if (megaduck_poll_rtc())
+        (void)megaduck_rtc_get_sec();
+    bench_record("rtc_poll_process", sim_work_cycles - start);
+}
+
+
+// Every scan code and modifier combination with each model's layout
+static void bench_keycode_to_ascii(void) {
+    volatile char sink = 0;
+
+    uint64_t start = sim_work_cycles;
+    for (uint8_t model = 0u; model < MEGADUCK_MODEL_COUNT; model++) {
+        megaduck_keymap_select(model);
+        for (uint8_t flags = 0u; flags < BENCH_ASCII_FLAGS; flags++)
+            for (uint16_t code = 0u; code < 256u; code++)
+                sink += megaduck_keycode_to_ascii((uint8_t)code, flags);
+    }
+    (void)sink;
+    bench_record("keycode_to_ascii", (sim_work_cycles - start) / (MEGADUCK_MODEL_COUNT * BENCH_ASCII_FLAGS * 256u));
+    megaduck_keymap_select(MEGADUCK_HANDHELD_STANDARD);
+}
+
+
+// Looks up "<target> <name> <mcycles>" in the baseline file
+static bool bench_baseline_get(const char * path, const char * target, const char * name, uint64_t * p_mcycles) {
+    char line[128], line_target[BENCH_NAME_LEN], line_name[BENCH_NAME_LEN];
+    unsigned long long value;
+    bool found = false;
+    FILE * f = fopen(path, "r");
+
+    if (!f) return false;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') continue;
+        if ((sscanf(line, "%39s %39s %llu", line_target, line_name, &value) == 3) &&
+            !strcmp(line_target, target) && !strcmp(line_name, name)) {
+            *p_mcycles = value;
+            found = true;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+
+// Rewrites the baseline entries for this target, keeping the others
+static bool bench_baseline_update(const char * path, const char * target) {
+    char   line[128], line_target[BENCH_NAME_LEN];
+    char * kept = NULL;
+    size_t kept_len = 0u;
+    FILE * f = fopen(path, "r");
+
+    if (f) {
+        while (fgets(line, sizeof(line), f)) {
+            if ((line[0] != '#') && (sscanf(line, "%39s", line_target) == 1) && !strcmp(line_target, target))
+                continue;
+            kept = realloc(kept, kept_len + strlen(line) + 1u);
+            memcpy(kept + kept_len, line, strlen(line) + 1u);
+            kept_len += strlen(line);
+        }
+        fclose(f);
+    }
+
+    f = fopen(path, "w");
+    if (!f) { free(kept); return false; }
+    if (kept) fputs(kept, f);
+    else      fputs("# <target> <operation> <M-cycles>, update with: make bench-update\n", f);
+    for (uint8_t c = 0u; c < bench_result_count; c++)
+        fprintf(f, "%s %s %llu\n", target, bench_results[c].name, (unsigned long long)bench_results[c].mcycles);
+    fclose(f);
+    free(kept);
+    return true;
+}
+
+
+int main(int argc, char * argv[]) {
+
+    uint8_t failures = 0u;
+
+    if (argc < 3) {
+        printf("Usage: %s <megaduck|gb> <baseline file> [--update]\n", argv[0]);
+        return 2;
+    }
+    const char * target        = argv[1];
+    const char * baseline_path = argv[2];
+    bool         update        = (argc > 3) && !strcmp(argv[3], "--update");
+
+    bench_laptop_present = !strcmp(target, "megaduck");
+
+    bench_controller_init();
+    bench_keyboard();
+    bench_rtc();
+    bench_keycode_to_ascii();
+
+    printf("== %s ==\n", target);
+    for (uint8_t c = 0u; c < bench_result_count; c++) {
+        uint64_t baseline;
+        const char * status = "NEW ";
+
+        if (!update && bench_baseline_get(baseline_path, target, bench_results[c].name, &baseline)) {
+            if (bench_results[c].mcycles * 100u > baseline * (100u + BENCH_TOLERANCE_PCT)) {
+                status = "FAIL";
+                failures++;
+            } else
+                status = "ok  ";
+        }
+        printf("%s  %-24s %10llu M-cycles  %8.1f scanlines\n", status, bench_results[c].name,
+            (unsigned long long)bench_results[c].mcycles, (double)bench_results[c].mcycles / SIM_MCYCLES_PER_SCANLINE);
+    }
+
+    if (update && !bench_baseline_update(baseline_path, target)) {
+        printf("Could not write %s\n", baseline_path);
+        return 2;
+    }
+
+    return (failures) ? 1 : 0;
+}
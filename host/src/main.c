@@ -0,0 +1,1139 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <gbdk/platform.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_link_sched.h>
+#include <megaduck_link_overlay.h>
+#include <megaduck_link_trace.h>
+#include <megaduck_keycodes.h>
+#include <megaduck_model.h>
+
+#include "megaduck_keyboard.h"
+#include "megaduck_key2ascii.h"
+#include "megaduck_piano.h"
+#include "megaduck_rtc.h"
+#include "megaduck_rtc_service.h"
+#include "megaduck_display.h"
+
+#include "sim_peripheral.h"
+#include "sim_replay.h"
+
+// Runs the protocol code against the simulated peripheral
+//
+// Each scenario scripts the peripheral (including injected faults),
+// runs one protocol operation and checks the outcome. Virtual time
+// is reported in M-cycles and scanlines.
+
+typedef bool (*scenario_fn)(void);
+
+typedef struct scenario_t {
+    const char * name;
+    scenario_fn  run;
+} scenario_t;
+
+static uint8_t scenario_failures;
+
+
+#define EXPECT(cond) do { if (!(cond)) { printf("    expected: %s  (line %d)\n", #cond, __LINE__); return false; } } while (0)
+
+
+// Fresh peripheral that has already done the init handshake
+static void periph_ready(void) {
+    sim_hw_reset();
+    sim_periph_reset();
+    megaduck_tick_init();
+    sim_periph_force_initialized();
+    serial_io_policy = serial_io_policy_default;
+}
+
+
+// Longest a blocking call may take with the current policy, see serial_io_policy_t
+static uint64_t policy_worst_case_mcycles(void) {
+    uint8_t  attempts = serial_io_policy.retries + 1u;
+    uint32_t ticks    = ((uint32_t)serial_io_policy.deadline_ticks * attempts) +
+                        ((uint32_t)serial_io_policy.backoff_ticks * ((1u << serial_io_policy.retries) - 1u));
+
+    // Each attempt may also send its Abort byte after the deadline, and start
+    // up to a tick late against the deadline (tick counts are whole ticks)
+    ticks += attempts;
+    return ((uint64_t)ticks * SIM_MCYCLES_PER_TIMA_4KHZ) + ((uint64_t)attempts * SIM_MCYCLES_PER_LINK_BYTE);
+}
+
+
+static bool scenario_init_ok(void) {
+    sim_hw_reset();
+    sim_periph_reset();
+    sim_periph.cmd_0x09_reply = 0x5Au;
+
+    EXPECT(megaduck_laptop_init());
+    EXPECT(sim_periph.initialized);
+    EXPECT(serial_cmd_0x09_reply_data == 0x5Au);
+    return true;
+}
+
+
+static bool scenario_init_absent(void) {
+    sim_hw_reset();
+    sim_periph_reset();
+    sim_periph.fault = SIM_FAULT_ABSENT;
+
+    EXPECT(!megaduck_laptop_init());
+    return true;
+}
+
+
+// Background init runs from the serial interrupt while frames keep going
+static bool scenario_init_background(void) {
+    uint16_t frames = 0u;
+
+    sim_hw_reset();
+    sim_periph_reset();
+    sim_periph.cmd_0x09_reply = 0xA5u;
+
+    EXPECT(megaduck_laptop_init_begin());
+    while ((megaduck_laptop_init_status() == MEGADUCK_LAPTOP_INIT_PENDING) && (frames < 120u)) {
+        vsync();
+        frames++;
+    }
+    EXPECT(megaduck_laptop_init_status() == MEGADUCK_LAPTOP_INIT_OK);
+    EXPECT(sim_periph.initialized);
+    EXPECT(serial_cmd_0x09_reply_data == 0xA5u);
+    // ~512 link bytes, at least 30 frames went by meanwhile
+    EXPECT(frames >= 30u);
+
+    // Link is ready for commands
+    EXPECT(megaduck_keyboard_poll_keys());
+
+    // Nothing attached: fails shortly after the count up
+    sim_hw_reset();
+    sim_periph_reset();
+    sim_periph.fault = SIM_FAULT_ABSENT;
+    frames = 0u;
+
+    EXPECT(megaduck_laptop_init_begin());
+    while ((megaduck_laptop_init_status() == MEGADUCK_LAPTOP_INIT_PENDING) && (frames < 120u)) {
+        vsync();
+        frames++;
+    }
+    EXPECT(megaduck_laptop_init_status() == MEGADUCK_LAPTOP_INIT_FAILED);
+    EXPECT(frames <= 17u);
+    return true;
+}
+
+
+// Model detection from the font tiles the laptop System ROM leaves in VRAM
+static bool scenario_model_detect(void) {
+    static const uint8_t spanish_tiles[32] = {
+        0x00u, 0x00u, 0x18u, 0x18u, 0x00u, 0x00u, 0x38u, 0x38u, 0x70u, 0x70u, 0x72u, 0x72u, 0x76u, 0x76u, 0x3Cu, 0x3Cu,
+        0x00u, 0x00u, 0x18u, 0x18u, 0x00u, 0x00u, 0x18u, 0x18u, 0x3Cu, 0x3Cu, 0x3Cu, 0x3Cu, 0x3Cu, 0x3Cu, 0x18u, 0x18u,
+    };
+    static const uint8_t german_tiles[32] = {
+        0x00u, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u, 0xFFu, 0xFFu, 0xFFu, 0xFFu,
+        0x00u, 0xFFu, 0x00u, 0xC3u, 0x00u, 0x99u, 0x00u, 0x99u, 0x00u, 0x99u, 0x00u, 0x99u, 0x00u, 0xC3u, 0x00u, 0xFFu,
+    };
+    uint8_t * p_tiles = &sim_vram[0x0D00u];
+
+    sim_hw_reset();
+    sim_vram_blocked_reads = 0u;
+
+    memcpy(p_tiles, spanish_tiles, sizeof(spanish_tiles));
+    megaduck_laptop_check_model_vram_on_startup();
+    EXPECT(megaduck_model == MEGADUCK_LAPTOP_SPANISH);
+
+    memcpy(p_tiles, german_tiles, sizeof(german_tiles));
+    megaduck_laptop_check_model_vram_on_startup();
+    EXPECT(megaduck_model == MEGADUCK_LAPTOP_GERMAN);
+
+    // Same hash (+1, -2, +1 keeps both sums), different check byte
+    p_tiles[19] += 1u;
+    p_tiles[20] -= 2u;
+    p_tiles[21] += 1u;
+    megaduck_laptop_check_model_vram_on_startup();
+    EXPECT(megaduck_model == MEGADUCK_HANDHELD_STANDARD);
+
+    memset(p_tiles, 0x00u, sizeof(german_tiles));
+    megaduck_laptop_check_model_vram_on_startup();
+    EXPECT(megaduck_model == MEGADUCK_HANDHELD_STANDARD);
+
+    EXPECT(sim_vram_blocked_reads == 0u);
+    return true;
+}
+
+
+// Quick init skips the handshake when the startup model check found no laptop
+static bool scenario_init_quick(void) {
+    sim_hw_reset();
+    sim_periph_reset();
+
+    megaduck_model = MEGADUCK_HANDHELD_STANDARD;
+    uint64_t start = sim_cycles;
+    EXPECT(!megaduck_laptop_init_quick());
+    EXPECT(sim_periph.rx_count == 0u);
+    EXPECT((sim_cycles - start) < SIM_MCYCLES_PER_LINK_BYTE);
+
+    megaduck_model = MEGADUCK_LAPTOP_SPANISH;
+    EXPECT(megaduck_laptop_init_quick());
+    EXPECT(sim_periph.initialized);
+    megaduck_model = MEGADUCK_HANDHELD_STANDARD;
+    return true;
+}
+
+
+static bool scenario_keys_ok(void) {
+    periph_ready();
+    sim_periph.key_flags = MEGADUCK_KEY_FLAG_SHIFT;
+    sim_periph.key_code  = MEGADUCK_KEY_A;
+
+    EXPECT(megaduck_keyboard_poll_keys());
+    EXPECT(megaduck_key_flags == MEGADUCK_KEY_FLAG_SHIFT);
+    EXPECT(megaduck_key_code  == MEGADUCK_KEY_A);
+    EXPECT(sim_periph.acks_ok == 1u);
+
+    megaduck_keyboard_process_keys();
+    EXPECT(megaduck_key_pressed == 'A');
+    return true;
+}
+
+
+// Keymap lookups map in the keymap bank once per call and put the caller's bank back
+static bool scenario_banked_keymap(void) {
+
+    uint32_t switches = sim_rom_switches;
+
+    sim_rom_bank = 5u;
+    megaduck_keymap_select(MEGADUCK_LAPTOP_SPANISH);
+    EXPECT((sim_rom_switches - switches) == 2u);
+    EXPECT(sim_rom_bank == 5u);
+
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_A, 0u) == 'a');
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_A, MEGADUCK_KEY_FLAG_SHIFT) == 'A');
+    EXPECT(megaduck_keycode_to_ascii(0x00u, 0u) == NO_KEY);
+    EXPECT((sim_rom_switches - switches) == 8u);
+    EXPECT(sim_rom_bank == 5u);
+
+    // Caps Lock only changes letters, Caps Lock + Shift gives the plain character
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_A, MEGADUCK_KEY_FLAG_CAPSLOCK) == 'A');
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_N_TILDE, MEGADUCK_KEY_FLAG_CAPSLOCK) == (char)0xA5u);  // Ñ
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_1, MEGADUCK_KEY_FLAG_CAPSLOCK) == '1');
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_A, MEGADUCK_KEY_FLAG_CAPSLOCK | MEGADUCK_KEY_FLAG_SHIFT) == 'a');
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_PIANO_DO, 0u) == NO_KEY);
+
+    // German keys that differ from Spanish, the rest is shared with it
+    megaduck_keymap_select(MEGADUCK_LAPTOP_GERMAN);
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_Y, 0u) == 'z');
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_Y, MEGADUCK_KEY_FLAG_CAPSLOCK) == 'Z');
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_BACKTICK, MEGADUCK_KEY_FLAG_CAPSLOCK) == (char)0x9Au);  // Ü
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_DASH, 0u) == '@');
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_DASH, MEGADUCK_KEY_FLAG_CAPSLOCK) == '@');
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_DIVIDE, MEGADUCK_KEY_FLAG_SHIFT) == NO_KEY);
+    EXPECT(megaduck_keycode_to_ascii(MEGADUCK_KEY_A, MEGADUCK_KEY_FLAG_SHIFT) == 'A');
+    EXPECT(sim_rom_bank == 5u);
+
+    megaduck_keymap_select(MEGADUCK_HANDHELD_STANDARD);
+    sim_rom_bank = 1u;
+    return true;
+}
+
+
+static bool scenario_keys_bad_checksum(void) {
+    periph_ready();
+    sim_periph.fault       = SIM_FAULT_BAD_CHECKSUM;
+    sim_periph.fault_count = 1u;
+
+    // Aborted, then recovered by the retry
+    EXPECT(megaduck_keyboard_poll_keys());
+    EXPECT(sim_periph.acks_abort == 1u);
+    EXPECT(sim_periph.acks_ok == 1u);
+
+    serial_io_policy.retries = 0u;
+    sim_periph.fault_count   = 1u;
+    EXPECT(!megaduck_keyboard_poll_keys());
+    EXPECT(megaduck_keyboard_poll_keys());
+    return true;
+}
+
+
+static bool scenario_keys_timeout(void) {
+    periph_ready();
+    sim_periph.fault       = SIM_FAULT_DROP_BYTE;
+    sim_periph.fault_param = 2u;
+    sim_periph.fault_count = 1u;
+    serial_io_policy.retries = 0u;
+
+    EXPECT(!megaduck_keyboard_poll_keys());
+    EXPECT(sim_periph.acks_abort == 1u);
+    EXPECT(megaduck_keyboard_poll_keys());
+    return true;
+}
+
+
+static bool scenario_keys_bad_length(void) {
+    periph_ready();
+    sim_periph.fault       = SIM_FAULT_BAD_LENGTH;
+    sim_periph.fault_param = MEGADUCK_RX_MAX_PAYLOAD_LEN + 1u;
+    sim_periph.fault_count = 1u;
+    serial_io_policy.retries = 0u;
+
+    EXPECT(!megaduck_keyboard_poll_keys());
+    EXPECT(megaduck_keyboard_poll_keys());
+
+    // Shorter than a keyboard reply: the fixed size receive stops at the header
+    sim_periph.fault_param = SYS_REPLY_KBD_PAYLOAD_LEN + 1u;
+    sim_periph.fault_count = 1u;
+    EXPECT(!serial_io_receive_keys(megaduck_serial_rx_buf));
+    EXPECT(megaduck_serial_rx_buf_len == 0u);
+    EXPECT(serial_io_receive_keys(megaduck_serial_rx_buf));
+    EXPECT(megaduck_serial_rx_buf_len == SYS_REPLY_KBD_PAYLOAD_LEN);
+    return true;
+}
+
+
+static bool scenario_keys_async(void) {
+    uint8_t frames = 0u;
+    uint8_t status;
+
+    periph_ready();
+    sim_periph.key_code = MEGADUCK_KEY_Q;
+
+    // Start at the top of a frame, virtual time carries over between scenarios
+    vsync();
+    EXPECT(megaduck_keyboard_request_keys());
+    // The main loop keeps running frames while the packet is in flight
+    do {
+        vsync();
+        frames++;
+        status = megaduck_keyboard_check_keys();
+    } while ((status == SERIAL_IO_STATUS_BUSY) && (frames < 10u));
+
+    EXPECT(status == SERIAL_IO_STATUS_DONE);
+    EXPECT(frames == 1u);
+    EXPECT(megaduck_key_code == MEGADUCK_KEY_Q);
+    return true;
+}
+
+
+// Keyboard every 2 frames and RTC every 60 frames sharing the link,
+// plus a one-shot RTC set
+static bool scenario_sched_keys_rtc(void) {
+    uint16_t keys_done = 0u;
+    uint16_t rtc_done  = 0u;
+    uint16_t failed    = 0u;
+    uint8_t  status;
+
+    periph_ready();
+    megaduck_sched_init();
+    megaduck_keyboard_schedule_keys(2u);
+    megaduck_schedule_rtc(60u, &megaduck_rtc);
+
+    for (uint16_t frame = 0u; frame < 240u; frame++) {
+        vsync();
+        if (frame == 100u)
+            megaduck_schedule_send_rtc();
+
+        megaduck_sched_update();
+
+        status = megaduck_keyboard_get_scheduled_keys();
+        if (status == SERIAL_IO_STATUS_DONE)   keys_done++;
+        if (status == SERIAL_IO_STATUS_FAILED) failed++;
+
+        status = megaduck_get_scheduled_rtc();
+        if (status == SERIAL_IO_STATUS_DONE)   rtc_done++;
+        if (status == SERIAL_IO_STATUS_FAILED) failed++;
+
+        if (megaduck_get_scheduled_send_rtc() == SERIAL_IO_STATUS_FAILED) failed++;
+    }
+
+    EXPECT(failed == 0u);
+    EXPECT(sim_periph.acks_abort == 0u);
+    EXPECT(sim_periph.rtc_set_count == 1u);
+    EXPECT(rtc_done >= 4u);
+    // Every other frame, minus the slots given to the RTC
+    EXPECT(keys_done >= (240u / 2u) - rtc_done - 3u);
+    EXPECT(sim_periph.min_cmd_gap >= ((uint64_t)MEGADUCK_SCHED_SPACING_TICKS * SIM_MCYCLES_PER_TIMA_4KHZ));
+    return true;
+}
+
+
+static bool scenario_keys_events(void) {
+    megaduck_key_event_t event;
+
+    // Start with no key held and nothing queued
+    periph_ready();
+    EXPECT(megaduck_keyboard_poll_keys());
+    megaduck_keyboard_flush_events();
+
+    // Press, hardware repeat, release
+    sim_periph.key_code = MEGADUCK_KEY_W;
+    EXPECT(megaduck_keyboard_poll_keys());
+    EXPECT(megaduck_keyboard_key_held(MEGADUCK_KEY_W));
+
+    // The scan code is only evaluated once
+    uint8_t key_code = MEGADUCK_KEY_W - 1u;
+    EXPECT(megaduck_keyboard_key_held(++key_code));
+    EXPECT(key_code == MEGADUCK_KEY_W);
+
+    sim_periph.key_flags = MEGADUCK_KEY_FLAG_KEY_REPEAT;
+    sim_periph.key_code  = 0x00u;
+    EXPECT(megaduck_keyboard_poll_keys());
+
+    sim_periph.key_flags = 0x00u;
+    EXPECT(megaduck_keyboard_poll_keys());
+    EXPECT(!megaduck_keyboard_key_held(MEGADUCK_KEY_W));
+
+    EXPECT(megaduck_keyboard_get_event(&event));
+    EXPECT((event.key_code == MEGADUCK_KEY_W) && (event.edge == KEY_EVENT_PRESS));
+    EXPECT(megaduck_keyboard_get_event(&event));
+    EXPECT((event.key_code == MEGADUCK_KEY_W) && (event.edge == KEY_EVENT_REPEAT));
+    EXPECT(megaduck_keyboard_get_event(&event));
+    EXPECT((event.key_code == MEGADUCK_KEY_W) && (event.edge == KEY_EVENT_RELEASE));
+    EXPECT(!megaduck_keyboard_get_event(&event));
+    return true;
+}
+
+
+// Period (11 bits) a channel was last started with, from its NRx3 / NRx4 pair
+static uint16_t piano_period_at(uint8_t nrx3) {
+    return sim_audio_regs[nrx3] | ((uint16_t)(sim_audio_regs[nrx3 + 1u] & 0x07u) << 8);
+}
+
+
+static bool scenario_piano(void) {
+    megaduck_key_event_t event;
+    uint32_t accesses;
+
+    periph_ready();
+    megaduck_piano_octave = 1u;
+    megaduck_piano_init();
+    EXPECT(sim_audio_regs[0x26u] == 0x80u);
+    EXPECT((sim_audio_regs[0x12u] == 0x00u) && (sim_audio_regs[0x17u] == 0x00u) && (sim_audio_regs[0x1Au] == 0x00u));
+
+    EXPECT(megaduck_piano_note_from_key(MEGADUCK_KEY_PIANO_DO)    == 0u);
+    EXPECT(megaduck_piano_note_from_key(MEGADUCK_KEY_PIANO_SI_2)  == 23u);
+    EXPECT(megaduck_piano_note_from_key(MEGADUCK_KEY_PRINTSCREEN_RIGHT) == MEGADUCK_PIANO_NO_NOTE);
+    EXPECT(megaduck_piano_note_from_key(MEGADUCK_KEY_MINUS)       == MEGADUCK_PIANO_NO_NOTE);
+    EXPECT(megaduck_piano_note_from_key(0x00u)                    == MEGADUCK_PIANO_NO_NOTE);
+
+    EXPECT(megaduck_keyboard_poll_keys());
+    megaduck_keyboard_flush_events();
+
+    // DO press plays C4 on Pulse 1 with only 3 register writes after the poll
+    sim_periph.key_code = MEGADUCK_KEY_PIANO_DO;
+    EXPECT(megaduck_keyboard_poll_keys());
+    EXPECT(megaduck_keyboard_get_event(&event));
+    accesses = sim_audio_accesses;
+    EXPECT(megaduck_piano_key_event(&event));
+    EXPECT((sim_audio_accesses - accesses) == 3u);
+    EXPECT(sim_audio_regs[0x14u] & 0x80u);
+    EXPECT(piano_period_at(0x13u) == 1547u);
+    EXPECT(sim_audio_regs[0x12u] != 0x00u);
+
+    // The next key releases DO first, LA then goes to a voice that was already free
+    sim_periph.key_code = MEGADUCK_KEY_PIANO_LA;
+    EXPECT(megaduck_keyboard_poll_keys());
+    while (megaduck_keyboard_get_event(&event))
+        EXPECT(megaduck_piano_key_event(&event));
+    EXPECT(sim_audio_regs[0x12u] == 0x00u);
+    EXPECT(piano_period_at(0x18u) == 1750u);
+    EXPECT(sim_audio_regs[0x17u] != 0x00u);
+
+    // Hardware repeat keeps it playing, release stops it
+    sim_periph.key_flags = MEGADUCK_KEY_FLAG_KEY_REPEAT;
+    sim_periph.key_code  = 0x00u;
+    EXPECT(megaduck_keyboard_poll_keys());
+    sim_periph.key_flags = 0x00u;
+    EXPECT(megaduck_keyboard_poll_keys());
+    while (megaduck_keyboard_get_event(&event))
+        EXPECT(megaduck_piano_key_event(&event));
+    EXPECT(sim_audio_regs[0x17u] == 0x00u);
+
+    // Other keys are left for the caller
+    sim_periph.key_code = MEGADUCK_KEY_W;
+    EXPECT(megaduck_keyboard_poll_keys());
+    EXPECT(megaduck_keyboard_get_event(&event));
+    EXPECT(!megaduck_piano_key_event(&event));
+    megaduck_keyboard_flush_events();
+
+    // Chords: Wave is the one free the longest, then the oldest note gets stolen
+    megaduck_piano_note_on(0u);
+    megaduck_piano_note_on(4u);
+    megaduck_piano_note_on(7u);
+    EXPECT((sim_audio_regs[0x1Au] == 0x80u) && (piano_period_at(0x1Du) == 1547u));
+    EXPECT(piano_period_at(0x13u) == 1650u);
+    EXPECT(piano_period_at(0x18u) == 1714u);
+    megaduck_piano_octave = 2u;
+    megaduck_piano_note_on(12u);
+    EXPECT(piano_period_at(0x1Du) == 1923u);
+
+    // Octaves past the table play at the top one
+    megaduck_piano_all_off();
+    megaduck_piano_octave = 200u;
+    megaduck_piano_note_on(12u);
+    EXPECT((piano_period_at(0x13u) == 1923u) || (piano_period_at(0x18u) == 1923u) || (piano_period_at(0x1Du) == 1923u));
+    megaduck_piano_octave = 1u;
+
+    megaduck_piano_all_off();
+    EXPECT((sim_audio_regs[0x12u] == 0x00u) && (sim_audio_regs[0x17u] == 0x00u) && (sim_audio_regs[0x1Au] == 0x00u));
+    return true;
+}
+
+
+// Holds A for the given number of frames, polling every poll_frames (0: never again
+// after the press) and running the repeat timer on the other frames, returns the repeats
+static uint8_t key_repeat_count(uint8_t poll_frames, uint8_t frames) {
+    uint8_t repeats = 0u;
+
+    periph_ready();
+    sim_periph.key_code = MEGADUCK_KEY_A;
+    if (!megaduck_keyboard_poll_keys()) return 0xFFu;
+    megaduck_keyboard_process_keys();
+    if (megaduck_key_pressed != 'a') return 0xFFu;
+
+    sim_periph.key_flags = MEGADUCK_KEY_FLAG_KEY_REPEAT;
+    sim_periph.key_code  = 0x00u;
+    for (uint8_t f = 1u; f <= frames; f++) {
+        vsync();
+        if (poll_frames && ((f % poll_frames) == 0u)) {
+            if (!megaduck_keyboard_poll_keys()) return 0xFFu;
+            megaduck_keyboard_process_keys();
+        } else
+            megaduck_keyboard_repeat_keys();
+        if (megaduck_key_pressed == 'a') repeats++;
+    }
+
+    // Release ends it
+    sim_periph.key_flags = 0x00u;
+    if (!megaduck_keyboard_poll_keys()) return 0xFFu;
+    megaduck_keyboard_process_keys();
+    vsync();
+    if (megaduck_keyboard_repeat_keys()) return 0xFFu;
+    return repeats;
+}
+
+
+static bool scenario_key_repeat(void) {
+    megaduck_key_repeat_delay = KEY_REPEAT_DELAY_FRAMES_DEFAULT;
+    megaduck_key_repeat_rate  = KEY_REPEAT_RATE_FRAMES_DEFAULT;
+
+    // Same repeats (at frames 18, 28, 38, 48, 58) whatever the poll interval
+    EXPECT(key_repeat_count(1u, 60u) == 5u);
+    EXPECT(key_repeat_count(2u, 60u) == 5u);
+    EXPECT(key_repeat_count(8u, 60u) == 5u);
+
+    // Without polls confirming the key is still down, repeats stop after the hold timeout
+    EXPECT(key_repeat_count(0u, 60u) == 2u);
+
+    megaduck_key_repeat_delay = 6u;
+    megaduck_key_repeat_rate  = 2u;
+    EXPECT(key_repeat_count(8u, 20u) == 8u);
+
+    megaduck_key_repeat_delay = KEY_REPEAT_DELAY_FRAMES_DEFAULT;
+    megaduck_key_repeat_rate  = KEY_REPEAT_RATE_FRAMES_DEFAULT;
+    return true;
+}
+
+
+static bool scenario_rtc_get(void) {
+    static const uint8_t rtc_bcd[8] = { 0x24u, 0x12u, 0x31u, 0x02u, 0x01u, 0x11u, 0x59u, 0x58u };
+
+    periph_ready();
+    for (uint8_t c = 0u; c < sizeof(rtc_bcd); c++)
+        sim_periph.rtc[c] = rtc_bcd[c];
+
+    EXPECT(megaduck_poll_rtc());
+    EXPECT(megaduck_rtc_get_year() == 2024u);
+    EXPECT(megaduck_rtc_get_mon()  == 12u);
+    EXPECT(megaduck_rtc_get_day()  == 31u);
+    EXPECT(megaduck_rtc_get_ampm() == 1u);
+    EXPECT(megaduck_rtc_get_hour() == 11u);
+    EXPECT(megaduck_rtc_get_min()  == 59u);
+    EXPECT(megaduck_rtc_get_sec()  == 58u);
+    return true;
+}
+
+
+// Difference between the local clock and the peripheral's running clock, in ticks
+static int32_t rtc_service_error(void) {
+    uint8_t  min, sec;
+    uint16_t ticks;
+
+    sim_periph_rtc_now(&min, &sec, &ticks);
+    int32_t truth = ((((int32_t)min * 60) + sec) * (int32_t)MEGADUCK_RTC_SUBSEC_PER_SEC) + ticks;
+    int32_t local = ((((int32_t)megaduck_rtc_get_min() * 60) + megaduck_rtc_get_sec()) * (int32_t)MEGADUCK_RTC_SUBSEC_PER_SEC) + megaduck_rtc_subsec;
+    return local - truth;
+}
+
+
+// Local clock locks to the RTC's seconds rollover, then runs
+// without serial traffic until the resync interval
+static bool scenario_rtc_service(void) {
+    static const uint8_t rtc_bcd[8] = { 0x93u, 0x06u, 0x01u, 0x02u, 0x00u, 0x03u, 0x15u, 0x00u };
+    uint16_t frames = 0u;
+    uint16_t reads;
+    int32_t  error;
+
+    periph_ready();
+    for (uint8_t c = 0u; c < sizeof(rtc_bcd); c++)
+        sim_periph.rtc[c] = rtc_bcd[c];
+    sim_periph.rtc_running = true;
+    sim_periph.rtc_phase   = 700000u;
+
+    megaduck_sched_init();
+    megaduck_rtc_service_init(5u);
+
+    while (!megaduck_rtc_service_synced() && (frames < 120u)) {
+        vsync();
+        megaduck_sched_update();
+        megaduck_rtc_service_update();
+        frames++;
+    }
+    EXPECT(megaduck_rtc_service_synced());
+    EXPECT(megaduck_rtc_get_hour() == 3u);
+    reads = sim_periph.rtc_get_count;
+
+    // Within a frame of the peripheral's clock for the next 8 seconds,
+    // with one resync in between
+    for (frames = 0u; frames < (8u * 60u); frames++) {
+        vsync();
+        megaduck_sched_update();
+        megaduck_rtc_service_update();
+
+        error = rtc_service_error();
+        EXPECT((error > -80) && (error < 80));
+    }
+    EXPECT(megaduck_rtc_service_state == MEGADUCK_RTC_SERVICE_LOCKED);
+    EXPECT(sim_periph.rtc_get_count > reads);
+    EXPECT((sim_periph.rtc_get_count - reads) <= 8u);
+    return true;
+}
+
+
+// RTC reads with out of range fields never reach the local clock
+static bool scenario_rtc_bad_sample(void) {
+    static const uint8_t rtc_bad[][8] = {
+        { 0x93u, 0x00u, 0x01u, 0x02u, 0x00u, 0x03u, 0x15u, 0x00u },  // Month 0
+        { 0x93u, 0x13u, 0x01u, 0x02u, 0x00u, 0x03u, 0x15u, 0x00u },  // Month 13
+        { 0x93u, 0x02u, 0x30u, 0x02u, 0x00u, 0x03u, 0x15u, 0x00u },  // Feb 30th
+        { 0x93u, 0x06u, 0x1Au, 0x02u, 0x00u, 0x03u, 0x15u, 0x00u },  // Bad BCD digit
+        { 0x93u, 0x06u, 0x01u, 0x07u, 0x00u, 0x03u, 0x15u, 0x00u },  // Weekday 7
+        { 0x93u, 0x06u, 0x01u, 0x02u, 0x00u, 0x12u, 0x15u, 0x00u },  // Hour 12 (0 - 11 with am/pm)
+    };
+    uint16_t frames;
+    uint8_t  failed;
+
+    for (uint8_t sample = 0u; sample < (sizeof(rtc_bad) / sizeof(rtc_bad[0])); sample++) {
+        periph_ready();
+        memcpy(sim_periph.rtc, rtc_bad[sample], sizeof(sim_periph.rtc));
+        sim_periph.rtc_running = true;
+
+        megaduck_sched_init();
+        megaduck_rtc_service_init(5u);
+        failed = megaduck_rtc_service_failed_reads;
+
+        for (frames = 0u; frames < 120u; frames++) {
+            vsync();
+            megaduck_sched_update();
+            megaduck_rtc_service_update();
+        }
+        EXPECT(!megaduck_rtc_service_synced());
+        EXPECT(megaduck_rtc_service_state == MEGADUCK_RTC_SERVICE_SEARCH);
+        EXPECT(megaduck_rtc_service_failed_reads != failed);
+    }
+
+    // Still searching, so a valid read locks as usual
+    sim_periph.rtc[1] = 0x06u;
+    sim_periph.rtc[2] = 0x01u;
+    sim_periph.rtc[3] = 0x02u;
+    sim_periph.rtc[5] = 0x03u;
+    for (frames = 0u; !megaduck_rtc_service_synced() && (frames < 120u); frames++) {
+        vsync();
+        megaduck_sched_update();
+        megaduck_rtc_service_update();
+    }
+    EXPECT(megaduck_rtc_service_synced());
+    EXPECT(megaduck_rtc_get_mon() == 6u);
+    return true;
+}
+
+
+// Divide free BCD conversions over their whole range,
+// and BCD values drawn straight as digit tiles
+static bool scenario_bcd(void) {
+    static const uint8_t date_bcd[2] = { 0x19u, 0x93u };
+    uint8_t field_date;
+
+    for (uint8_t value = 0u; value < 100u; value++) {
+        EXPECT(u8_to_bcd(value) == (((value / 10u) << 4) | (value % 10u)));
+        EXPECT(bcd_to_u8(u8_to_bcd(value)) == value);
+    }
+
+    sim_hw_reset();
+    megaduck_display_init();
+    field_date = megaduck_display_add_field(0u, 0u, 4u);
+    megaduck_display_set_bcd(field_date, date_bcd);
+    vsync();
+    sim_advance(SIM_MCYCLES_PER_SCANLINE);
+    EXPECT(memcmp(&sim_vram[0x1800u], "1993", 4u) == 0);
+    return true;
+}
+
+
+// Epoch seconds against the host's gmtime() for every day in 1992 - 2091
+static bool scenario_rtc_epoch(void) {
+    static const megaduck_rtc_data_t rtc_2024 = { 0x24u, 0x12u, 0x31u, 0x00u, 0x01u, 0x11u, 0x59u, 0x58u };
+    megaduck_rtc_data_t rtc;
+
+    for (uint32_t day = 0u; day < (MEGADUCK_RTC_EPOCH_END / MEGADUCK_RTC_SECS_PER_DAY); day++) {
+        uint32_t  secs = (day * MEGADUCK_RTC_SECS_PER_DAY) + ((day * 7919u) % MEGADUCK_RTC_SECS_PER_DAY);
+        time_t    unix_secs = (time_t)secs + MEGADUCK_RTC_EPOCH_UNIX_OFFSET;
+        struct tm tm;
+
+        gmtime_r(&unix_secs, &tm);
+        megaduck_rtc_from_epoch(secs, &rtc);
+        EXPECT(rtc.year    == u8_to_bcd((uint8_t)(tm.tm_year % 100)));
+        EXPECT(rtc.mon     == u8_to_bcd((uint8_t)(tm.tm_mon + 1)));
+        EXPECT(rtc.day     == u8_to_bcd((uint8_t)tm.tm_mday));
+        EXPECT(rtc.weekday == (uint8_t)tm.tm_wday);
+        EXPECT(rtc.ampm    == ((tm.tm_hour >= 12) ? 1u : 0u));
+        EXPECT(rtc.hour    == u8_to_bcd((uint8_t)(tm.tm_hour % 12)));
+        EXPECT(rtc.min     == u8_to_bcd((uint8_t)tm.tm_min));
+        EXPECT(rtc.sec     == u8_to_bcd((uint8_t)tm.tm_sec));
+        EXPECT(megaduck_rtc_to_epoch(&rtc) == secs);
+    }
+    EXPECT(megaduck_rtc_to_epoch(&rtc_2024) + MEGADUCK_RTC_EPOCH_UNIX_OFFSET == 1735689598UL);
+    EXPECT(megaduck_rtc_calc_weekday(&rtc_2024) == 2u);  // Tuesday
+
+    // The weekday of a sent time comes from its date
+    periph_ready();
+    megaduck_rtc_from_epoch(megaduck_rtc_to_epoch(&rtc_2024), &megaduck_rtc_send);
+    megaduck_rtc_send.weekday = 0x06u;
+    EXPECT(megaduck_send_rtc());
+    EXPECT(memcmp(sim_periph.rtc, &rtc_2024, 3u) == 0);
+    EXPECT(sim_periph.rtc[3] == 0x02u);
+    EXPECT(memcmp(&sim_periph.rtc[4], &rtc_2024.ampm, 4u) == 0);
+
+    megaduck_rtc_from_epoch(44668800UL, &megaduck_rtc_send);  // Back to the 1993-06-01 default
+    EXPECT(megaduck_rtc_send.weekday == 0x02u);
+    return true;
+}
+
+
+// Only changed tiles get written, and only from VBlank
+static bool scenario_display_dirty(void) {
+    uint8_t  field_time;
+    uint8_t  field_text[4];
+    uint32_t writes;
+
+    sim_hw_reset();
+    megaduck_display_init();
+    field_time = megaduck_display_add_field(7u, 10u, 8u);
+    EXPECT(field_time != MEGADUCK_DISPLAY_FIELD_NONE);
+
+    writes = sim_vram_writes;
+    megaduck_display_set_text(field_time, "11:59:58");
+    EXPECT(sim_vram_writes == writes);  // Nothing until VBlank
+    vsync();
+    sim_advance(SIM_MCYCLES_PER_SCANLINE);
+    EXPECT(sim_vram_writes == writes + 8u);
+    EXPECT(sim_vram[0x1800u + (10u * 32u) + 7u] == '1');
+    EXPECT(sim_vram[0x1800u + (10u * 32u) + 14u] == '8');
+
+    // Next second: one tile
+    writes = sim_vram_writes;
+    megaduck_display_set_text(field_time, "11:59:59");
+    megaduck_display_set_text(field_time, "11:59:59");
+    vsync();
+    sim_advance(SIM_MCYCLES_PER_SCANLINE);
+    EXPECT(sim_vram_writes == writes + 1u);
+    EXPECT(sim_vram[0x1800u + (10u * 32u) + 14u] == '9');
+
+    // Rollover of every digit: 6 tiles
+    writes = sim_vram_writes;
+    megaduck_display_set_text(field_time, "00:00:00");
+    vsync();
+    sim_advance(SIM_MCYCLES_PER_SCANLINE);
+    EXPECT(sim_vram_writes == writes + 6u);
+
+    // More changed tiles than the queue holds, then tiles that are still
+    // queued change again: only their last value may end up in VRAM
+    for (uint8_t c = 0u; c < 4u; c++) {
+        field_text[c] = megaduck_display_add_field(0u, 12u + c, 10u);
+        megaduck_display_set_text(field_text[c], "0123456789");
+    }
+    for (uint8_t c = 0u; c < 4u; c++)
+        megaduck_display_set_text(field_text[c], "ABCDEFGHIJ");
+    for (uint8_t c = 0u; c < 4u; c++) vsync();
+    sim_advance(SIM_MCYCLES_PER_SCANLINE);
+    for (uint8_t c = 0u; c < 4u; c++)
+        EXPECT(memcmp(&sim_vram[0x1800u + ((12u + c) * 32u)], "ABCDEFGHIJ", 10u) == 0);
+    return true;
+}
+
+
+static bool scenario_rtc_get_bad_checksum(void) {
+    periph_ready();
+    sim_periph.fault       = SIM_FAULT_BAD_CHECKSUM;
+    sim_periph.fault_count = SIM_FAULT_FOREVER;
+
+    // Every attempt fails
+    EXPECT(!megaduck_poll_rtc());
+    EXPECT(sim_periph.acks_abort == serial_io_policy.retries + 1u);
+    return true;
+}
+
+
+// Malformed packets fail early, and a bad link can't stall longer than the policy allows
+static bool scenario_retry_policy(void) {
+    uint64_t start;
+    uint8_t  keys_failed = 0u;
+    uint8_t  keys_done   = 0u;
+    uint8_t  status;
+
+    // Length header of 0 (would wrap to a huge payload): aborted
+    // right after the header, without waiting for any timeout
+    periph_ready();
+    serial_io_policy.retries = 0u;
+    sim_periph.fault       = SIM_FAULT_BAD_LENGTH;
+    sim_periph.fault_param = 0u;
+    sim_periph.fault_count = 1u;
+    start = sim_cycles;
+    EXPECT(!serial_io_send_command_and_receive_buffer(SYS_CMD_GET_KEYS, megaduck_serial_rx_buf, MEGADUCK_RX_MAX_PAYLOAD_LEN));
+    EXPECT(sim_periph.acks_abort == 1u);
+    EXPECT(megaduck_serial_rx_buf_len == 0u);
+    EXPECT((sim_cycles - start) < (4u * SIM_MCYCLES_PER_LINK_BYTE));
+
+    // Fits the buffer, but isn't the size of a keyboard reply
+    sim_periph.fault_param = 2u + SYS_REPLY_KBD_PAYLOAD_LEN + 1u;
+    sim_periph.fault_count = 1u;
+    EXPECT(!serial_io_send_command_and_receive_buffer(SYS_CMD_GET_KEYS, megaduck_serial_rx_buf, MEGADUCK_RX_MAX_PAYLOAD_LEN));
+    EXPECT(sim_periph.acks_abort == 2u);
+
+    // Peripheral stops answering mid reply on every attempt
+    periph_ready();
+    sim_periph.fault       = SIM_FAULT_DROP_BYTE;
+    sim_periph.fault_param = 3u;
+    sim_periph.fault_count = SIM_FAULT_FOREVER;
+    start = sim_cycles;
+    EXPECT(!megaduck_poll_rtc());
+    EXPECT(sim_periph.rtc_get_count == serial_io_policy.retries + 1u);
+    EXPECT((sim_cycles - start) <= policy_worst_case_mcycles());
+
+    // Bytes trickle in just inside the byte timeout, the deadline ends it
+    periph_ready();
+    sim_periph.reply_delay = (uint16_t)(((uint32_t)serial_io_policy.byte_timeout_ticks * SIM_MCYCLES_PER_TIMA_4KHZ) -
+                                        (2u * SIM_MCYCLES_PER_LINK_BYTE));
+    start = sim_cycles;
+    EXPECT(!megaduck_poll_rtc());
+    EXPECT((sim_cycles - start) <= policy_worst_case_mcycles());
+
+    // Scheduled: a single bad packet is retried without the caller seeing the failure
+    periph_ready();
+    megaduck_sched_init();
+    megaduck_keyboard_schedule_keys(2u);
+    sim_periph.fault       = SIM_FAULT_BAD_CHECKSUM;
+    sim_periph.fault_count = 1u;
+
+    for (uint8_t frame = 0u; frame < 20u; frame++) {
+        vsync();
+        megaduck_sched_update();
+        status = megaduck_keyboard_get_scheduled_keys();
+        if (status == SERIAL_IO_STATUS_DONE)   keys_done++;
+        if (status == SERIAL_IO_STATUS_FAILED) keys_failed++;
+    }
+    megaduck_sched_remove(MEGADUCK_SCHED_SLOT_KEYBOARD);
+
+    EXPECT(sim_periph.acks_abort == 1u);
+    EXPECT(keys_failed == 0u);
+    EXPECT(keys_done >= 5u);
+    return true;
+}
+
+
+// Reply bytes that finish right as serial_io_poll_transaction() decides on a timeout
+//
+// - Sweeps the reply timing across the byte timeout (and the deadline, which
+//   lands at about the same time for a keyboard reply), so bytes finish before,
+//   during and after the timeout check in the poll loop
+// - Whichever way it goes, the Duck's result has to match the final byte
+//   the peripheral got, and the next transaction has to work
+static bool scenario_poll_timeout_race(void) {
+    uint16_t done   = 0u;
+    uint16_t failed = 0u;
+    uint8_t  status;
+
+    for (uint16_t offset = 0u; offset < (2u * SIM_MCYCLES_PER_TIMA_4KHZ); offset++) {
+        uint16_t polls = 0u;
+
+        periph_ready();
+        serial_io_policy.retries = 0u;
+        sim_periph.key_code    = MEGADUCK_KEY_Q;
+        sim_periph.reply_delay = (uint16_t)(((uint32_t)serial_io_policy.byte_timeout_ticks * SIM_MCYCLES_PER_TIMA_4KHZ) -
+                                            (3u * SIM_MCYCLES_PER_LINK_BYTE / 2u) + offset);
+
+        EXPECT(megaduck_keyboard_request_keys());
+        do {
+            status = megaduck_keyboard_check_keys();
+        } while ((status == SERIAL_IO_STATUS_BUSY) && (++polls != 0u));
+
+        // Let the final byte reach the peripheral
+        sim_advance(2u * SIM_MCYCLES_PER_LINK_BYTE);
+
+        if (status == SERIAL_IO_STATUS_DONE) {
+            EXPECT((sim_periph.acks_ok == 1u) && (sim_periph.acks_abort == 0u));
+            done++;
+        } else {
+            EXPECT(status == SERIAL_IO_STATUS_FAILED);
+            EXPECT((sim_periph.acks_ok == 0u) && (sim_periph.acks_abort == 1u));
+            failed++;
+        }
+
+        sim_periph.reply_delay = 200u;
+        EXPECT(megaduck_keyboard_poll_keys());
+    }
+
+    // Both sides of the timeout were covered
+    EXPECT(done && failed);
+    return true;
+}
+
+
+static bool scenario_rtc_set(void) {
+    periph_ready();
+
+    EXPECT(megaduck_send_rtc());
+    EXPECT(sim_periph.rtc_set_count == 1u);
+    EXPECT(sim_periph.rtc[0] == 0x93u);  // Power-on default of 1993
+    EXPECT(sim_periph.rtc[1] == 0x06u);
+    return true;
+}
+
+
+static bool scenario_rtc_set_nak(void) {
+    periph_ready();
+    sim_periph.fault       = SIM_FAULT_NAK;
+    sim_periph.fault_param = 0x00u;
+    sim_periph.fault_count = 1u;
+
+    EXPECT(!megaduck_send_rtc());
+    EXPECT(sim_periph.rtc_set_count == 0u);
+    return true;
+}
+
+
+// Per command counters and latency histogram, and their overlay
+static bool scenario_link_stats(void) {
+    const megaduck_link_stats_t * p_keys = &megaduck_link_stats[MEGADUCK_LINK_STATS_KEYS];
+    const uint8_t * p_win = &sim_vram[0x1C00u];
+
+    periph_ready();
+    megaduck_link_stats_reset();
+
+    EXPECT(megaduck_keyboard_poll_keys());
+    EXPECT(p_keys->ok == 1u);
+    // 4 link bytes plus turnarounds: ~7 msec
+    EXPECT(p_keys->latency[1] == 1u);
+
+    sim_periph.fault       = SIM_FAULT_BAD_CHECKSUM;
+    sim_periph.fault_count = 1u;
+    EXPECT(megaduck_keyboard_poll_keys());
+    EXPECT(p_keys->bad_checksum == 1u);
+    EXPECT(p_keys->retries == 1u);
+    EXPECT(p_keys->ok == 2u);
+
+    serial_io_policy.retries = 0u;
+    sim_periph.fault       = SIM_FAULT_DROP_BYTE;
+    sim_periph.fault_param = 1u;
+    sim_periph.fault_count = 1u;
+    EXPECT(!megaduck_keyboard_poll_keys());
+    EXPECT(p_keys->timeouts == 1u);
+
+    sim_periph.fault       = SIM_FAULT_BAD_LENGTH;
+    sim_periph.fault_param = 0u;
+    sim_periph.fault_count = 1u;
+    EXPECT(!megaduck_keyboard_poll_keys());
+    EXPECT(p_keys->aborts == 1u);
+
+    EXPECT(megaduck_poll_rtc());
+    EXPECT(megaduck_link_stats[MEGADUCK_LINK_STATS_RTC_GET].ok == 1u);
+    EXPECT(megaduck_link_stats[MEGADUCK_LINK_STATS_RTC_GET].latency[3] == 1u);
+    EXPECT(p_keys->ok == 2u);
+
+    megaduck_link_overlay_show(true);
+    EXPECT(memcmp(p_win, "K 0002 T01C01A01R01 ", MEGADUCK_LINK_OVERLAY_WIDTH) == 0);
+    EXPECT(memcmp(p_win + 32u, "  00020000000000000", 18u) == 0);
+    EXPECT(memcmp(p_win + (2u * 32u), "G 0001 T00C00A00R00 ", MEGADUCK_LINK_OVERLAY_WIDTH) == 0);
+    EXPECT(*sim_reg(SIM_REG_LCDC) & LCDCF_WINON);
+
+    // One row per update
+    uint32_t writes = sim_vram_writes;
+    EXPECT(megaduck_keyboard_poll_keys());
+    megaduck_link_overlay_update();
+    EXPECT(sim_vram_writes == writes + MEGADUCK_LINK_OVERLAY_WIDTH);
+    EXPECT(memcmp(p_win, "K 0003", 6u) == 0);
+
+    megaduck_link_overlay_show(false);
+    EXPECT(!(*sim_reg(SIM_REG_LCDC) & LCDCF_WINON));
+    return true;
+}
+
+
+// VBlanks keep coming while the blocking init and back to back blocking polls run
+// (same as the VBLANK_TEST=1 build of the keyboard example)
+static bool scenario_vblank_keepalive(void) {
+    uint64_t start;
+    uint16_t vbl_start;
+    uint32_t frames;
+
+    sim_hw_reset();
+    sim_periph_reset();
+    *sim_reg(SIM_REG_IE) = VBL_IFLAG | TIM_IFLAG;
+    vsync();
+
+    start     = sim_cycles;
+    vbl_start = sys_time;
+    EXPECT(megaduck_laptop_init());
+    for (uint8_t c = 0u; c < 100u; c++) {
+        EXPECT(megaduck_keyboard_poll_keys());
+        EXPECT(megaduck_poll_rtc());
+    }
+    frames = (uint32_t)((sim_cycles - start) / SIM_MCYCLES_PER_FRAME);
+
+    EXPECT((uint16_t)(sys_time - vbl_start) >= frames);
+    // Other interrupt enables are left alone
+    EXPECT((*sim_reg(SIM_REG_IE) & (VBL_IFLAG | TIM_IFLAG)) == (VBL_IFLAG | TIM_IFLAG));
+    return true;
+}
+
+
+// A trace with failures and retries flushed to SRAM replays with the same outcome
+static bool scenario_trace_replay(void) {
+    static uint8_t image[SIM_SRAM_SIZE];
+    sim_replay_result_t result;
+    uint16_t image_len;
+    uint16_t count;
+
+    periph_ready();
+    megaduck_link_trace_reset();
+
+    EXPECT(megaduck_keyboard_poll_keys());
+    sim_periph.fault       = SIM_FAULT_BAD_CHECKSUM;  // Retried
+    sim_periph.fault_count = 1u;
+    EXPECT(megaduck_keyboard_poll_keys());
+    sim_periph.fault       = SIM_FAULT_DROP_BYTE;     // Times out, retried
+    sim_periph.fault_param = 4u;
+    sim_periph.fault_count = 1u;
+    EXPECT(megaduck_poll_rtc());
+    EXPECT(megaduck_send_rtc());
+    sim_periph.fault       = SIM_FAULT_NAK;
+    sim_periph.fault_param = 0x00u;
+    sim_periph.fault_count = 2u;                      // Fails on both attempts
+    EXPECT(!megaduck_send_rtc());
+
+    image_len = megaduck_link_trace_flush();
+    EXPECT(memcmp(sim_sram, MEGADUCK_LINK_TRACE_MAGIC, 4u) == 0);
+    memcpy(image, sim_sram, image_len);
+
+    EXPECT(sim_replay_load(image, image_len));
+    count = sim_replay_entry_count();
+    EXPECT((count == megaduck_link_trace_total) && (count < MEGADUCK_LINK_TRACE_LEN));
+
+    // Replay: same transactions, outcomes and Duck bytes
+    periph_ready();
+    megaduck_link_trace_reset();
+    sim_replay_run(&result);
+    EXPECT(result.transactions == 8u);
+    EXPECT(result.ok == 4u);
+    EXPECT((result.status_mismatch == 0u) && (result.tx_mismatch == 0u) && (result.skipped == 0u));
+
+    // ...and records the same trace again, apart from the ticks
+    EXPECT(megaduck_link_trace_flush() == image_len);
+    for (uint16_t c = 0u; c < count; c++) {
+        const uint8_t * p_was = &image[sizeof(megaduck_link_trace_header_t) + (c * sizeof(megaduck_link_trace_entry_t))];
+        const uint8_t * p_now = &sim_sram[sizeof(megaduck_link_trace_header_t) + (c * sizeof(megaduck_link_trace_entry_t))];
+        EXPECT((p_was[0] == p_now[0]) && (p_was[1] == p_now[1]));
+    }
+
+    // A reply byte changed in the trace changes the outcome
+    image[sizeof(megaduck_link_trace_header_t) + (3u * sizeof(megaduck_link_trace_entry_t)) + 1u] ^= 0x01u;
+    EXPECT(sim_replay_load(image, image_len));
+    periph_ready();
+    sim_replay_run(&result);
+    EXPECT(result.status_mismatch == 1u);
+
+    // Cut off at the start of the ring, the partial transaction is skipped
+    image[sizeof(megaduck_link_trace_header_t) + (3u * sizeof(megaduck_link_trace_entry_t)) + 1u] ^= 0x01u;
+    memmove(&image[sizeof(megaduck_link_trace_header_t)],
+            &image[sizeof(megaduck_link_trace_header_t) + (2u * sizeof(megaduck_link_trace_entry_t))],
+            (count - 2u) * sizeof(megaduck_link_trace_entry_t));
+    image[6] = (uint8_t)(count - 2u);
+    EXPECT(sim_replay_load(image, image_len));
+    periph_ready();
+    sim_replay_run(&result);
+    EXPECT((result.transactions == 7u) && (result.skipped == 1u) && (result.status_mismatch == 0u));
+    return true;
+}
+
+
+static const scenario_t scenarios[] = {
+    { "init_ok",               scenario_init_ok },
+    { "init_absent",           scenario_init_absent },
+    { "init_quick",            scenario_init_quick },
+    { "init_background",       scenario_init_background },
+    { "model_detect",          scenario_model_detect },
+    { "keys_ok",               scenario_keys_ok },
+    { "banked_keymap",         scenario_banked_keymap },
+    { "keys_bad_checksum",     scenario_keys_bad_checksum },
+    { "keys_timeout",          scenario_keys_timeout },
+    { "keys_bad_length",       scenario_keys_bad_length },
+    { "keys_async",            scenario_keys_async },
+    { "keys_events",           scenario_keys_events },
+    { "piano",                 scenario_piano },
+    { "key_repeat",            scenario_key_repeat },
+    { "sched_keys_rtc",        scenario_sched_keys_rtc },
+    { "rtc_get",               scenario_rtc_get },
+    { "rtc_get_bad_checksum",  scenario_rtc_get_bad_checksum },
+    { "retry_policy",          scenario_retry_policy },
+    { "poll_timeout_race",     scenario_poll_timeout_race },
+    { "link_stats",            scenario_link_stats },
+    { "vblank_keepalive",      scenario_vblank_keepalive },
+    { "trace_replay",          scenario_trace_replay },
+    { "rtc_service",           scenario_rtc_service },
+    { "rtc_bad_sample",        scenario_rtc_bad_sample },
+    { "bcd",                   scenario_bcd },
+    { "rtc_epoch",             scenario_rtc_epoch },
+    { "display_dirty",         scenario_display_dirty },
+    { "rtc_set",               scenario_rtc_set },
+    { "rtc_set_nak",           scenario_rtc_set_nak },
+};
+
+
+int main(void) {
+
+    for (uint8_t c = 0u; c < (sizeof(scenarios) / sizeof(scenarios[0])); c++) {
+
+        uint64_t start = sim_cycles;
+        bool     ok;
+
+        sim_ime_faults = 0u;
+        ok = scenarios[c].run();
+        uint64_t spent = sim_cycles - start;
+
+        // Interrupts turned on inside a critical section or handler fail any scenario
+        if (sim_ime_faults) {
+            printf("    interrupts turned on early %u time(s)\n", (unsigned)sim_ime_faults);
+            ok = false;
+        }
+
+        printf("%s  %-24s %10llu M-cycles  %8.1f scanlines\n",
+            ok ? "PASS" : "FAIL", scenarios[c].name,
+            (unsigned long long)spent, (double)spent / SIM_MCYCLES_PER_SCANLINE);
+
+        if (!ok) scenario_failures++;
+    }
+
+    return (scenario_failures) ? 1 : 0;
+}
@@ -0,0 +1,70 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <gbdk/platform.h>
+
+#include <megaduck_laptop_io.h>
+#include <megaduck_tick.h>
+
+#include "sim_peripheral.h"
+#include "sim_replay.h"
+
+// Replays a link trace flushed to cartridge SRAM (a .sav file, or
+// any file starting with the trace header) against the protocol code
+//
+// Usage: megaduck_replay [--dump] <trace file>
+//   --dump: also list the trace entries
+//
+// Exits with 1 if any transaction turned out differently than in the trace
+
+static uint8_t replay_image[sizeof(sim_sram)];
+
+
+int main(int argc, char * argv[]) {
+
+    sim_replay_result_t result;
+    const char * path = NULL;
+    bool     dump = false;
+    FILE *   f;
+    uint32_t len;
+
+    for (int c = 1; c < argc; c++) {
+        if (strcmp(argv[c], "--dump") == 0) dump = true;
+        else path = argv[c];
+    }
+    if (path == NULL) {
+        fprintf(stderr, "usage: megaduck_replay [--dump] <trace file>\n");
+        return 2;
+    }
+
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        fprintf(stderr, "megaduck_replay: can't open %s\n", path);
+        return 2;
+    }
+    len = (uint32_t)fread(replay_image, 1u, sizeof(replay_image), f);
+    fclose(f);
+
+    if (!sim_replay_load(replay_image, len)) {
+        fprintf(stderr, "megaduck_replay: %s has no link trace\n", path);
+        return 2;
+    }
+    if (dump) sim_replay_dump();
+
+    sim_hw_reset();
+    sim_periph_reset();
+    megaduck_tick_init();
+    sim_periph_force_initialized();
+
+    sim_replay_run(&result);
+
+    printf("entries %u  transactions %u  ok %u  skipped %u\n", (unsigned)sim_replay_entry_count(),
+           (unsigned)result.transactions, (unsigned)result.ok, (unsigned)result.skipped);
+    printf("status mismatches %u  tx mismatches %u\n", (unsigned)result.status_mismatch, (unsigned)result.tx_mismatch);
+    printf("%llu M-cycles in transactions (%.1f scanlines)\n", (unsigned long long)result.mcycles,
+           (double)result.mcycles / SIM_MCYCLES_PER_SCANLINE);
+
+    return ((result.status_mismatch == 0u) && (result.tx_mismatch == 0u)) ? 0 : 1;
+}
@@ -0,0 +1,354 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <gbdk/platform.h>
+
+#include "sim_peripheral.h"
+
+
+// Serial link transfer in progress
+#define SIM_LINK_IDLE       0u
+#define SIM_LINK_DUCK_TX    1u  // Duck is clocking a byte out (internal clock)
+#define SIM_LINK_PERIPH_TX  2u  // Peripheral is clocking a byte in (external clock)
+
+#define SIM_VBL_HANDLERS_MAX  4u
+
+uint64_t sim_cycles;
+uint64_t sim_work_cycles;
+uint8_t  sim_vram[SIM_VRAM_SIZE];
+uint8_t  sim_sram[SIM_SRAM_SIZE];
+uint16_t sim_vram_blocked_reads;
+uint32_t sim_vram_writes;
+volatile uint8_t sim_audio_regs[0x40u];
+uint32_t sim_audio_accesses;
+uint8_t  sim_rom_bank = 1u;
+uint32_t sim_rom_switches;
+uint16_t sim_ime_faults;
+
+volatile uint16_t sys_time;
+
+static volatile uint8_t sim_regs[SIM_REG_COUNT];
+static bool     sim_ime;
+static bool     sim_in_isr;
+static uint8_t  sim_critical_depth;
+static uint64_t sim_isr_work_cycles;  // Part of sim_work_cycles spent in interrupt handlers
+static uint64_t sim_timer_last;     // Cycle TIMA was last advanced at
+static uint64_t sim_frame_next;     // Cycle of the next VBlank
+
+static uint8_t  sim_link_state;
+static uint8_t  sim_link_byte;
+static uint64_t sim_link_done_at;
+
+static void (*sim_vbl_handlers[SIM_VBL_HANDLERS_MAX])(void);
+static uint8_t sim_vbl_handler_count;
+
+static const uint16_t sim_tac_period[4] = { 256u, 4u, 16u, 64u };  // M-cycles per TIMA increment
+
+
+extern void sio_isr(void);
+
+
+static void sim_work(uint32_t mcycles) {
+
+    sim_work_cycles += mcycles;
+    if (sim_in_isr) sim_isr_work_cycles += mcycles;
+}
+
+
+// Called for every basic block of the modules built with -fsanitize-coverage=trace-pc
+void __sanitizer_cov_trace_pc(void) {
+    sim_work(SIM_MCYCLES_PER_BLOCK);
+}
+
+
+static void sim_step_link(void) {
+
+    uint8_t sc = sim_regs[SIM_REG_SC];
+
+    if (sim_link_state == SIM_LINK_IDLE) {
+        if ((sc & (SIOF_XFER_START | SIOF_CLOCK_INT)) == (SIOF_XFER_START | SIOF_CLOCK_INT)) {
+            sim_link_state   = SIM_LINK_DUCK_TX;
+            sim_link_byte    = sim_regs[SIM_REG_SB];
+            sim_link_done_at = sim_cycles + SIM_MCYCLES_PER_LINK_BYTE;
+        }
+        else if (((sc & (SIOF_XFER_START | SIOF_CLOCK_INT)) == SIOF_XFER_START) && sim_periph_tx_ready()) {
+            sim_link_state   = SIM_LINK_PERIPH_TX;
+            sim_link_byte    = sim_periph_tx_take();
+            sim_link_done_at = sim_cycles + SIM_MCYCLES_PER_LINK_BYTE;
+        }
+        return;
+    }
+
+    if (sim_cycles < sim_link_done_at) return;
+
+    if (sim_link_state == SIM_LINK_DUCK_TX) {
+        // Nothing drives the line back during a Duck TX, so it reads as idle high
+        sim_regs[SIM_REG_SB]  = 0xFFu;
+        sim_regs[SIM_REG_SC] &= ~SIOF_XFER_START;
+        sim_regs[SIM_REG_IF] |= SIO_IFLAG;
+        sim_link_state = SIM_LINK_IDLE;
+        sim_periph_rx_byte(sim_link_byte);
+    } else {
+        // The byte only lands if the Duck is still waiting for it
+        if ((sc & (SIOF_XFER_START | SIOF_CLOCK_INT)) == SIOF_XFER_START) {
+            sim_regs[SIM_REG_SB]  = sim_link_byte;
+            sim_regs[SIM_REG_SC] &= ~SIOF_XFER_START;
+            sim_regs[SIM_REG_IF] |= SIO_IFLAG;
+        } else
+            sim_periph_tx_lost(sim_link_byte);
+        sim_link_state = SIM_LINK_IDLE;
+    }
+}
+
+
+static void sim_step(void) {
+
+    // Timer
+    if (sim_regs[SIM_REG_TAC] & TACF_START) {
+        uint16_t period = sim_tac_period[sim_regs[SIM_REG_TAC] & 0x03u];
+        while ((sim_cycles - sim_timer_last) >= period) {
+            sim_timer_last += period;
+            if (++sim_regs[SIM_REG_TIMA] == 0u) {
+                sim_regs[SIM_REG_TIMA] = sim_regs[SIM_REG_TMA];
+                sim_regs[SIM_REG_IF] |= TIM_IFLAG;
+            }
+        }
+    } else
+        sim_timer_last = sim_cycles;
+
+    sim_regs[SIM_REG_DIV] = (uint8_t)(sim_cycles >> 6);  // 16384 Hz
+
+    // LCD
+    // Frames start at VBlank, like the VBlank interrupt
+    sim_regs[SIM_REG_LY] = (uint8_t)((((sim_cycles % SIM_MCYCLES_PER_FRAME) / SIM_MCYCLES_PER_SCANLINE)
+                                      + SIM_LY_VBLANK_START) % SIM_LY_COUNT);
+    while (sim_cycles >= sim_frame_next) {
+        sim_frame_next += SIM_MCYCLES_PER_FRAME;
+        sim_regs[SIM_REG_IF] |= VBL_IFLAG;
+    }
+
+    // Serial, a finished transfer may be followed right away by the next one
+    sim_step_link();
+    sim_step_link();
+}
+
+
+static void sim_dispatch(void) {
+
+    uint8_t pending;
+
+    if (!sim_ime || sim_in_isr) return;
+
+    while ((pending = (sim_regs[SIM_REG_IE] & sim_regs[SIM_REG_IF] & 0x1Fu))) {
+
+        sim_in_isr = true;
+        sim_ime    = false;
+
+        // Same priority order as the hardware
+        if (pending & VBL_IFLAG) {
+            sim_regs[SIM_REG_IF] &= ~VBL_IFLAG;
+            sys_time++;
+            for (uint8_t c = 0u; c < sim_vbl_handler_count; c++)
+                sim_vbl_handlers[c]();
+        }
+        else if (pending & LCD_IFLAG) sim_regs[SIM_REG_IF] &= ~LCD_IFLAG;
+        else if (pending & TIM_IFLAG) sim_regs[SIM_REG_IF] &= ~TIM_IFLAG;
+        else if (pending & SIO_IFLAG) {
+            sim_regs[SIM_REG_IF] &= ~SIO_IFLAG;
+            sio_isr();
+        }
+        else sim_regs[SIM_REG_IF] &= ~JOY_IFLAG;
+
+        sim_ime    = true;  // reti
+        sim_in_isr = false;
+    }
+}
+
+
+// Every register access costs some time and lets the hardware models run
+volatile uint8_t * sim_reg(uint8_t reg) {
+
+    sim_cycles += SIM_MCYCLES_PER_REG_ACCESS;
+    sim_work(SIM_MCYCLES_PER_REG_ACCESS);
+    sim_step();
+    sim_dispatch();
+
+    return &sim_regs[reg];
+}
+
+
+// Audio registers are plain storage, the APU itself isn't simulated
+volatile uint8_t * sim_audio_reg(uint8_t addr) {
+
+    sim_cycles += SIM_MCYCLES_PER_REG_ACCESS;
+    sim_work(SIM_MCYCLES_PER_REG_ACCESS);
+    sim_step();
+    sim_dispatch();
+
+    sim_audio_accesses++;
+    return &sim_audio_regs[addr & 0x3Fu];
+}
+
+
+// ROM bank switches are an MBC register write, banked data itself is plain memory
+void sim_switch_rom(uint8_t bank) {
+
+    sim_cycles += SIM_MCYCLES_PER_REG_ACCESS;
+    sim_work(SIM_MCYCLES_PER_REG_ACCESS);
+    sim_step();
+    sim_dispatch();
+
+    sim_rom_switches++;
+    sim_rom_bank = bank;
+}
+
+
+// Resets the simulated hardware (but not the virtual clock or timer setup)
+void sim_hw_reset(void) {
+
+    sim_regs[SIM_REG_SB]   = 0x00u;
+    sim_regs[SIM_REG_SC]   = 0x00u;
+    sim_regs[SIM_REG_IF]   = 0x00u;
+    sim_regs[SIM_REG_IE]   = VBL_IFLAG;  // As left by the GBDK crt
+    sim_regs[SIM_REG_FF60] = 0x00u;
+    sim_regs[SIM_REG_LCDC] = LCDCF_ON;
+
+    if (sim_frame_next == 0u) sim_frame_next = SIM_MCYCLES_PER_FRAME;
+
+    sim_ime            = true;
+    sim_in_isr         = false;
+    sim_critical_depth = 0u;
+    sim_link_state     = SIM_LINK_IDLE;
+}
+
+
+// Lets time pass without any register accesses from the program
+void sim_advance(uint32_t mcycles) {
+
+    while (mcycles) {
+        uint32_t chunk = (mcycles > 32u) ? 32u : mcycles;
+        sim_cycles += chunk;
+        mcycles    -= chunk;
+        sim_step();
+        sim_dispatch();
+    }
+}
+
+
+void sim_advance_to_vblank(void) {
+
+    uint64_t target = sim_frame_next;
+
+    sim_advance((uint32_t)(target - sim_cycles));
+}
+
+
+// == IME ==
+
+// Start of a CRITICAL block, returns the IME state to restore at the end
+//
+// - The SM83 can't read IME back, so SDCC ends every critical section
+//   with ei. Entering one with IME off (from an interrupt handler or
+//   another critical section) would turn interrupts on too early there
+bool sim_critical_enter(void) {
+
+    bool ime = sim_ime;
+
+    if (!ime) sim_ime_faults++;
+    sim_ime = false;
+    sim_critical_depth++;
+    return ime;
+}
+
+
+// End of a CRITICAL block
+//
+// - Anything that came up during the block is taken right after, like after ei
+void sim_critical_exit(bool ime) {
+
+    sim_critical_depth--;
+    sim_ime = ime;
+    sim_dispatch();
+}
+
+
+// == Wait loops ==
+
+// Start of a MEGADUCK_WAIT_WHILE() loop, returns the mark to pass to sim_wait_idle()
+uint64_t sim_wait_begin(void) {
+    return sim_work_cycles - sim_isr_work_cycles;
+}
+
+
+// End of a wait loop pass that didn't end the wait
+//
+// - Takes the pass back out of sim_work_cycles, so only the pass that ends
+//   the wait counts. Interrupt handlers that ran during it still count
+void sim_wait_idle(uint64_t mark) {
+    sim_work_cycles = mark + sim_isr_work_cycles;
+}
+
+
+// == GBDK calls ==
+
+// Only the main loop outside of critical sections may turn interrupts on
+void enable_interrupts(void) {
+    if (sim_in_isr || sim_critical_depth) sim_ime_faults++;
+    sim_ime = true;
+    sim_dispatch();
+}
+
+void disable_interrupts(void) { sim_ime = false; }
+
+
+// Like GBDK: sets IE, clears pending interrupts and enables them
+void set_interrupts(uint8_t flags) {
+    sim_regs[SIM_REG_IE] = flags;
+    sim_regs[SIM_REG_IF] = 0x00u;
+    enable_interrupts();
+}
+
+
+void add_VBL(void (*handler)(void)) {
+    if (sim_vbl_handler_count < SIM_VBL_HANDLERS_MAX)
+        sim_vbl_handlers[sim_vbl_handler_count++] = handler;
+}
+
+
+void vsync(void) {
+    sim_advance_to_vblank();
+}
+
+
+uint8_t get_vram_byte(uint8_t * addr) {
+    sim_cycles += SIM_MCYCLES_PER_REG_ACCESS;
+    sim_work(SIM_MCYCLES_PER_REG_ACCESS);
+    return sim_vram[((uintptr_t)addr - SIM_VRAM_BASE) & (SIM_VRAM_SIZE - 1u)];
+}
+
+
+// Copies without waiting for VRAM access, any byte read while
+// the LCD is drawing would be garbage on hardware so it's counted
+void sim_vram_read(void * p_dest, const void * p_vram, uint16_t len) {
+
+    uint8_t * p_out = (uint8_t *)p_dest;
+    uint16_t  addr  = (uint16_t)(uintptr_t)p_vram;
+
+    while (len--) {
+        sim_cycles += SIM_MCYCLES_PER_VRAM_COPY;
+        sim_work(SIM_MCYCLES_PER_VRAM_COPY);
+        sim_step();
+        if ((sim_regs[SIM_REG_LCDC] & LCDCF_ON) && (sim_regs[SIM_REG_LY] < SIM_LY_VBLANK_START))
+            sim_vram_blocked_reads++;
+        *p_out++ = sim_vram[(addr++ - SIM_VRAM_BASE) & (SIM_VRAM_SIZE - 1u)];
+    }
+}
+
+
+void set_vram_byte(uint8_t * addr, uint8_t v) {
+    sim_cycles += SIM_MCYCLES_PER_REG_ACCESS;
+    sim_work(SIM_MCYCLES_PER_REG_ACCESS);
+    sim_vram_writes++;
+    sim_vram[((uintptr_t)addr - SIM_VRAM_BASE) & (SIM_VRAM_SIZE - 1u)] = v;
+}
@@ -0,0 +1,298 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <sim_hw.h>
+#include <megaduck_laptop_io.h>
+
+#include "sim_peripheral.h"
+#include "sim_replay.h"
+
+
+// Protocol state
+#define PERIPH_INIT_COUNT_UP    0u  // Waiting for the 0..255 count up from the Duck
+#define PERIPH_INIT_WAIT_REQ    1u  // Sent boot ok, waiting for the countdown request
+#define PERIPH_INIT_WAIT_ACK    2u  // Sent 255..0, waiting for ok / abort
+#define PERIPH_CMD              3u  // Initialized, waiting for a command
+#define PERIPH_WAIT_PACKET_ACK  4u  // Sent a reply packet, waiting for ok / abort
+#define PERIPH_RTC_SET_LEN      5u  // Receiving a buffer from the Duck: length header
+#define PERIPH_RTC_SET_DATA     6u  // Receiving a buffer from the Duck: payload + checksum
+
+sim_periph_t sim_periph;
+
+static uint8_t  periph_state;
+static uint8_t  periph_count;
+static uint8_t  periph_rx_remaining;
+static uint8_t  periph_rx_checksum;
+static uint8_t  periph_rx_buf[MEGADUCK_TX_MAX_PAYLOAD_LEN + 2u];
+static uint8_t  periph_rx_len;
+
+static uint8_t  periph_tx_buf[SIM_PERIPH_REPLY_BUF_MAX];
+static uint16_t periph_tx_head;
+static uint16_t periph_tx_tail;
+static uint64_t periph_tx_ready_at;
+static uint64_t periph_last_cmd_at;
+
+
+static bool periph_fault_active(uint8_t fault) {
+    return (sim_periph.fault == fault) && (sim_periph.fault_count != 0u);
+}
+
+
+static void periph_fault_used(void) {
+    if ((sim_periph.fault_count != 0u) && (sim_periph.fault_count != SIM_FAULT_FOREVER))
+        sim_periph.fault_count--;
+}
+
+
+static void periph_queue(uint8_t tx_byte) {
+    if (periph_tx_tail < SIM_PERIPH_REPLY_BUF_MAX)
+        periph_tx_buf[periph_tx_tail++] = tx_byte;
+}
+
+
+// Queues a length + payload + checksum reply packet, with any faults applied
+static void periph_queue_packet(const uint8_t * p_payload, uint8_t payload_len) {
+
+    uint8_t packet[MEGADUCK_RX_MAX_PAYLOAD_LEN + 1u];
+    uint8_t packet_len = payload_len + 2u;  // Length header + payload + checksum
+    uint8_t checksum   = packet_len;
+
+    packet[0] = packet_len;
+    for (uint8_t c = 0u; c < payload_len; c++) {
+        packet[c + 1u] = p_payload[c];
+        checksum += p_payload[c];
+    }
+    packet[packet_len - 1u] = ~checksum + 1u;
+
+    if (periph_fault_active(SIM_FAULT_BAD_CHECKSUM)) {
+        packet[packet_len - 1u]++;
+        periph_fault_used();
+    }
+    else if (periph_fault_active(SIM_FAULT_BAD_LENGTH)) {
+        packet[0] = sim_periph.fault_param;
+        periph_fault_used();
+    }
+
+    for (uint8_t c = 0u; c < packet_len; c++) {
+        if (periph_fault_active(SIM_FAULT_DROP_BYTE) && (c == sim_periph.fault_param))
+            continue;
+        periph_queue(packet[c]);
+    }
+    if (periph_fault_active(SIM_FAULT_DROP_BYTE))
+        periph_fault_used();
+}
+
+
+static void periph_queue_ack(uint8_t ack) {
+    if (periph_fault_active(SIM_FAULT_NAK)) {
+        ack = sim_periph.fault_param;
+        periph_fault_used();
+    }
+    periph_queue(ack);
+}
+
+
+static uint8_t periph_bcd_to_u8(uint8_t bcd) {
+    return ((bcd >> 4) * 10u) + (bcd & 0x0Fu);
+}
+
+
+static uint8_t periph_u8_to_bcd(uint8_t value) {
+    return ((value / 10u) << 4) | (value % 10u);
+}
+
+
+// Current time of the running clock, minutes and seconds in binary
+// plus the position inside the current second in 4096 Hz ticks
+void sim_periph_rtc_now(uint8_t * p_min, uint8_t * p_sec, uint16_t * p_ticks) {
+
+    uint64_t now  = sim_cycles + sim_periph.rtc_phase;
+    uint64_t secs = (now / SIM_MCYCLES_PER_SEC) + periph_bcd_to_u8(sim_periph.rtc[7]) +
+                    (periph_bcd_to_u8(sim_periph.rtc[6]) * 60u);
+
+    if (!sim_periph.rtc_running) {
+        now  = 0u;
+        secs = periph_bcd_to_u8(sim_periph.rtc[7]) + (periph_bcd_to_u8(sim_periph.rtc[6]) * 60u);
+    }
+    *p_min   = (secs / 60u) % 60u;
+    *p_sec   = secs % 60u;
+    *p_ticks = (now % SIM_MCYCLES_PER_SEC) / SIM_MCYCLES_PER_TIMA_4KHZ;
+}
+
+
+static void periph_handle_command(uint8_t cmd) {
+
+    uint8_t  payload[2];
+    uint8_t  rtc[8];
+    uint16_t ticks;
+
+    if ((sim_cycles - periph_last_cmd_at) < sim_periph.min_cmd_gap)
+        sim_periph.min_cmd_gap = sim_cycles - periph_last_cmd_at;
+    periph_last_cmd_at = sim_cycles;
+
+    switch (cmd) {
+        case SYS_CMD_GET_KEYS:
+            sim_periph.keys_count++;
+            payload[0] = sim_periph.key_flags;
+            payload[1] = sim_periph.key_code;
+            periph_queue_packet(payload, sizeof(payload));
+            periph_state = PERIPH_WAIT_PACKET_ACK;
+            break;
+
+        case SYS_CMD_RTC_GET_DATE_AND_TIME:
+            sim_periph.rtc_get_count++;
+            memcpy(rtc, sim_periph.rtc, sizeof(rtc));
+            sim_periph_rtc_now(&rtc[6], &rtc[7], &ticks);
+            rtc[6] = periph_u8_to_bcd(rtc[6]);
+            rtc[7] = periph_u8_to_bcd(rtc[7]);
+            periph_queue_packet(rtc, sizeof(rtc));
+            periph_state = PERIPH_WAIT_PACKET_ACK;
+            break;
+
+        case SYS_CMD_RTC_SET_DATE_AND_TIME:
+            periph_queue_ack(SYS_REPLY_SEND_BUFFER_OK);
+            periph_state = PERIPH_RTC_SET_LEN;
+            break;
+
+        case SYS_CMD_INIT_UNKNOWN_0x09:
+            periph_queue(sim_periph.cmd_0x09_reply);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+void sim_periph_reset(void) {
+
+    memset(&sim_periph, 0, sizeof(sim_periph));
+    sim_periph.reply_delay = 200u;
+    sim_periph.min_cmd_gap = UINT64_MAX;
+    periph_last_cmd_at     = 0u;
+
+    periph_state   = PERIPH_INIT_COUNT_UP;
+    periph_count   = 0u;
+    periph_tx_head = 0u;
+    periph_tx_tail = 0u;
+}
+
+
+// A byte from the Duck has arrived
+void sim_periph_rx_byte(uint8_t rx_byte) {
+
+    if (sim_replay_active()) {
+        sim_replay_rx_byte(rx_byte);
+        return;
+    }
+    if (sim_periph.fault == SIM_FAULT_ABSENT) return;
+
+    sim_periph.rx_count++;
+    periph_tx_ready_at = sim_cycles + sim_periph.reply_delay;
+
+    switch (periph_state) {
+
+        case PERIPH_INIT_COUNT_UP:
+            // Restart the count on anything out of sequence
+            if (rx_byte != periph_count) periph_count = 0u;
+            if (rx_byte == periph_count) {
+                if (++periph_count == 0u) {
+                    periph_queue(SYS_REPLY_BOOT_OK);
+                    periph_state = PERIPH_INIT_WAIT_REQ;
+                }
+            }
+            break;
+
+        case PERIPH_INIT_WAIT_REQ:
+            if (rx_byte == SYS_CMD_INIT_SEQ_REQUEST) {
+                uint8_t c = 255u;
+                do { periph_queue(c); } while (c-- != 0u);
+                periph_state = PERIPH_INIT_WAIT_ACK;
+            } else
+                periph_state = PERIPH_INIT_COUNT_UP;
+            break;
+
+        case PERIPH_INIT_WAIT_ACK:
+            sim_periph.initialized = (rx_byte == SYS_CMD_DONE_OR_OK);
+            periph_state = (sim_periph.initialized) ? PERIPH_CMD : PERIPH_INIT_COUNT_UP;
+            periph_count = 0u;
+            break;
+
+        case PERIPH_WAIT_PACKET_ACK:
+            if (rx_byte == SYS_CMD_DONE_OR_OK)         sim_periph.acks_ok++;
+            else if (rx_byte == SYS_CMD_ABORT_OR_FAIL) sim_periph.acks_abort++;
+            // Any unsent part of the packet is dropped
+            periph_tx_head = periph_tx_tail = 0u;
+            periph_state = PERIPH_CMD;
+            break;
+
+        case PERIPH_RTC_SET_LEN:
+            // Length includes the header and checksum bytes
+            if ((rx_byte < 3u) || (rx_byte > sizeof(periph_rx_buf) + 1u)) {
+                periph_state = PERIPH_CMD;
+                break;
+            }
+            periph_rx_checksum  = rx_byte;
+            periph_rx_remaining = rx_byte - 1u;
+            periph_rx_len       = 0u;
+            periph_queue_ack(SYS_REPLY_SEND_BUFFER_OK);
+            periph_state = PERIPH_RTC_SET_DATA;
+            break;
+
+        case PERIPH_RTC_SET_DATA:
+            periph_rx_checksum += rx_byte;
+            periph_rx_buf[periph_rx_len++] = rx_byte;
+            if (--periph_rx_remaining) {
+                periph_queue_ack(SYS_REPLY_SEND_BUFFER_OK);
+                break;
+            }
+            // Checksum byte received
+            if ((periph_rx_checksum == 0x00u) && (periph_rx_len == sizeof(sim_periph.rtc) + 1u)) {
+                memcpy(sim_periph.rtc, periph_rx_buf, sizeof(sim_periph.rtc));
+                sim_periph.rtc_set_count++;
+                periph_queue_ack(SYS_REPLY_BUFFER_SEND_AND_CHECKSUM_OK);
+            } else
+                periph_queue_ack(SYS_REPLY_READ_FAIL_MAYBE);
+            periph_state = PERIPH_CMD;
+            break;
+
+        case PERIPH_CMD:
+            periph_handle_command(rx_byte);
+            break;
+    }
+}
+
+
+bool sim_periph_tx_ready(void) {
+    if (sim_replay_active()) return sim_replay_tx_ready();
+    return (periph_tx_head != periph_tx_tail) && (sim_cycles >= periph_tx_ready_at);
+}
+
+
+uint8_t sim_periph_tx_take(void) {
+
+    if (sim_replay_active()) return sim_replay_tx_take();
+
+    uint8_t tx_byte = periph_tx_buf[periph_tx_head++];
+
+    if (periph_tx_head == periph_tx_tail)
+        periph_tx_head = periph_tx_tail = 0u;
+
+    sim_periph.tx_count++;
+    periph_tx_ready_at = sim_cycles + SIM_MCYCLES_PER_LINK_BYTE + sim_periph.reply_delay;
+    return tx_byte;
+}
+
+
+void sim_periph_tx_lost(uint8_t tx_byte) {
+    (void)tx_byte;
+    sim_periph.tx_lost++;
+}
+
+
+// Skips the init handshake, as if the peripheral was already initialized
+void sim_periph_force_initialized(void) {
+    sim_periph.initialized = true;
+    periph_state = PERIPH_CMD;
+}
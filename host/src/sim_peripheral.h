@@ -0,0 +1,59 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef _SIM_PERIPHERAL_H
+#define _SIM_PERIPHERAL_H
+
+// Scripted model of the laptop peripheral on the other end of the serial link
+
+// Fault injection, applied to the reply packets of the next
+// sim_periph.fault_count commands (SIM_FAULT_FOREVER for all)
+#define SIM_FAULT_NONE          0u
+#define SIM_FAULT_ABSENT        1u  // Nothing connected, never answers
+#define SIM_FAULT_DROP_BYTE     2u  // Reply byte at fault_param is never sent (Duck times out)
+#define SIM_FAULT_BAD_CHECKSUM  3u  // Reply checksum is off by one
+#define SIM_FAULT_BAD_LENGTH    4u  // Reply length header is replaced with fault_param
+#define SIM_FAULT_NAK           5u  // Buffer send acks are replaced with fault_param
+
+#define SIM_FAULT_FOREVER       0xFFu
+
+#define SIM_PERIPH_REPLY_BUF_MAX  260u
+
+typedef struct sim_periph_t {
+    // Script
+    uint8_t  key_flags;
+    uint8_t  key_code;
+    uint8_t  rtc[8];             // BCD, same order as the RTC reply payload
+    uint8_t  cmd_0x09_reply;
+    uint16_t reply_delay;        // M-cycles between receiving a byte and a reply byte being ready
+    bool     rtc_running;        // Seconds and minutes in rtc[] advance with sim_cycles
+    uint64_t rtc_phase;          // M-cycles added to sim_cycles for the running clock, rtc[] is the time at 0
+
+    uint8_t  fault;
+    uint8_t  fault_param;
+    uint8_t  fault_count;
+
+    // Observed
+    bool     initialized;        // Completed the init handshake
+    uint16_t rx_count;           // Bytes received from the Duck
+    uint16_t tx_count;           // Bytes sent to the Duck
+    uint16_t tx_lost;            // Bytes clocked out while the Duck wasn't listening
+    uint16_t acks_ok;            // SYS_CMD_DONE_OR_OK after a reply packet
+    uint16_t acks_abort;         // SYS_CMD_ABORT_OR_FAIL after a reply packet
+    uint16_t rtc_set_count;      // Successful RTC set commands
+    uint16_t keys_count;         // Keyboard commands received
+    uint16_t rtc_get_count;      // RTC get commands received
+    uint64_t min_cmd_gap;        // Shortest time between two commands in M-cycles
+} sim_periph_t;
+
+extern sim_periph_t sim_periph;
+
+void    sim_periph_reset(void);
+void    sim_periph_rx_byte(uint8_t rx_byte);
+bool    sim_periph_tx_ready(void);
+uint8_t sim_periph_tx_take(void);
+void    sim_periph_tx_lost(uint8_t tx_byte);
+void    sim_periph_force_initialized(void);
+void    sim_periph_rtc_now(uint8_t * p_min, uint8_t * p_sec, uint16_t * p_ticks);
+
+#endif // _SIM_PERIPHERAL_H
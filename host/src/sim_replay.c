@@ -0,0 +1,239 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <gbdk/platform.h>
+#include <megaduck_laptop_io.h>
+#include <megaduck_link_trace.h>
+
+#include "sim_replay.h"
+
+
+#define REPLAY_HEADER_SIZE  10u  // Packed size of megaduck_link_trace_header_t on the Duck
+#define REPLAY_ENTRY_SIZE   4u
+
+static megaduck_link_trace_entry_t replay_entries[SIM_REPLAY_ENTRIES_MAX];
+static uint16_t replay_count;
+
+// Peripheral side
+static bool     replay_running;
+static uint16_t replay_cursor;          // Next trace entry the peripheral expects
+static uint16_t replay_tx_mismatch;
+static uint8_t  replay_q_byte[SIM_REPLAY_ENTRIES_MAX];
+static uint32_t replay_q_delay[SIM_REPLAY_ENTRIES_MAX];  // M-cycles to wait before sending each byte
+static uint16_t replay_q_head;
+static uint16_t replay_q_tail;
+static uint64_t replay_q_ready_at;
+
+
+// Loads an SRAM image written by megaduck_link_trace_flush()
+bool sim_replay_load(const uint8_t * p_image, uint32_t len) {
+
+    uint16_t count;
+
+    replay_count = 0u;
+
+    if ((len < REPLAY_HEADER_SIZE) || (memcmp(p_image, MEGADUCK_LINK_TRACE_MAGIC, 4u) != 0) ||
+        (p_image[4] != MEGADUCK_LINK_TRACE_VERSION) || (p_image[5] != REPLAY_ENTRY_SIZE))
+        return false;
+
+    count = p_image[6] | ((uint16_t)p_image[7] << 8);
+    if ((count > SIM_REPLAY_ENTRIES_MAX) || (len < REPLAY_HEADER_SIZE + ((uint32_t)count * REPLAY_ENTRY_SIZE)))
+        return false;
+
+    p_image += REPLAY_HEADER_SIZE;
+    for (uint16_t c = 0u; c < count; c++, p_image += REPLAY_ENTRY_SIZE) {
+        replay_entries[c].type = p_image[0];
+        replay_entries[c].data = p_image[1];
+        replay_entries[c].tick = p_image[2] | ((uint16_t)p_image[3] << 8);
+    }
+    replay_count = count;
+    return true;
+}
+
+
+uint16_t sim_replay_entry_count(void) {
+    return replay_count;
+}
+
+
+void sim_replay_dump(void) {
+
+    static const char * const names[] = { "?", "BEGIN", "TX", "RX", "TIMEOUT", "END" };
+
+    for (uint16_t c = 0u; c < replay_count; c++) {
+        uint8_t type = replay_entries[c].type;
+        printf("%5u  tick %04X  %-8s %02X\n", (unsigned)c, (unsigned)replay_entries[c].tick,
+               names[(type <= MEGADUCK_TRACE_END) ? type : 0u], (unsigned)replay_entries[c].data);
+    }
+}
+
+
+// == Peripheral side ==
+
+bool sim_replay_active(void) {
+    return replay_running;
+}
+
+
+// A byte from the Duck: check it against the trace, then queue the
+// bytes the peripheral sent after it with their recorded timing
+void sim_replay_rx_byte(uint8_t rx_byte) {
+
+    uint16_t prev_tick;
+    uint32_t link_mcycles;
+
+    // Anything not sent yet is dropped, like the peripheral model does
+    replay_q_head = replay_q_tail = 0u;
+
+    // A timeout is the Duck's doing, the NAK after it comes next
+    while ((replay_cursor < replay_count) && (replay_entries[replay_cursor].type == MEGADUCK_TRACE_TIMEOUT))
+        replay_cursor++;
+
+    if ((replay_cursor < replay_count) && (replay_entries[replay_cursor].type == MEGADUCK_TRACE_TX)) {
+        if (replay_entries[replay_cursor].data != rx_byte) replay_tx_mismatch++;
+        replay_cursor++;
+    } else {
+        replay_tx_mismatch++;
+        return;
+    }
+
+    // TX entries are stamped when the byte starts, RX entries when it's done,
+    // so the first reply byte comes after two link byte times
+    prev_tick    = replay_entries[replay_cursor - 1u].tick;
+    link_mcycles = 2u * SIM_MCYCLES_PER_LINK_BYTE;
+
+    while ((replay_cursor < replay_count) && (replay_entries[replay_cursor].type == MEGADUCK_TRACE_RX)) {
+        uint32_t gap = (uint32_t)(uint16_t)(replay_entries[replay_cursor].tick - prev_tick) * SIM_MCYCLES_PER_TIMA_4KHZ;
+
+        replay_q_byte[replay_q_tail]  = replay_entries[replay_cursor].data;
+        replay_q_delay[replay_q_tail] = (gap > link_mcycles) ? (gap - link_mcycles) : 0u;
+        replay_q_tail++;
+
+        prev_tick    = replay_entries[replay_cursor].tick;
+        link_mcycles = SIM_MCYCLES_PER_LINK_BYTE;
+        replay_cursor++;
+    }
+    if (replay_q_tail) replay_q_ready_at = sim_cycles + replay_q_delay[0];
+}
+
+
+bool sim_replay_tx_ready(void) {
+    return (replay_q_head != replay_q_tail) && (sim_cycles >= replay_q_ready_at);
+}
+
+
+uint8_t sim_replay_tx_take(void) {
+
+    uint8_t tx_byte = replay_q_byte[replay_q_head++];
+
+    if (replay_q_head != replay_q_tail)
+        replay_q_ready_at = sim_cycles + SIM_MCYCLES_PER_LINK_BYTE + replay_q_delay[replay_q_head];
+    return tx_byte;
+}
+
+
+// == Duck side ==
+
+// Rebuilds the buffer of a send transaction from its TX entries: [cmd][len][payload..][checksum]
+static void replay_load_tx_buf(uint16_t first, uint16_t end) {
+
+    uint8_t tx_count = 0u;
+
+    megaduck_serial_tx_buf_len = 0u;
+    memset(megaduck_serial_tx_buf, 0x00u, sizeof(megaduck_serial_tx_buf));
+
+    for (uint16_t c = first; c < end; c++) {
+        if (replay_entries[c].type != MEGADUCK_TRACE_TX) continue;
+
+        if (tx_count == 1u)
+            megaduck_serial_tx_buf_len = (replay_entries[c].data >= 2u) ? (uint8_t)(replay_entries[c].data - 2u) : 0u;
+        else if ((tx_count >= 2u) && ((tx_count - 2u) < megaduck_serial_tx_buf_len) &&
+                 ((tx_count - 2u) < MEGADUCK_TX_MAX_PAYLOAD_LEN))
+            megaduck_serial_tx_buf[tx_count - 2u] = replay_entries[c].data;
+        tx_count++;
+    }
+    if (megaduck_serial_tx_buf_len > MEGADUCK_TX_MAX_PAYLOAD_LEN)
+        megaduck_serial_tx_buf_len = MEGADUCK_TX_MAX_PAYLOAD_LEN;
+}
+
+
+// Replays every complete transaction in the loaded trace
+//
+// - The peripheral should be initialized and the engine idle
+void sim_replay_run(sim_replay_result_t * p_result) {
+
+    uint64_t start      = sim_cycles;
+    uint64_t elapsed    = 0u;  // M-cycles from the first transaction, by the recorded ticks
+    uint16_t prev_tick  = 0u;  // Tick of the previous transaction start
+    bool     started    = false;
+    uint16_t idx        = 0u;
+
+    memset(p_result, 0, sizeof(*p_result));
+    replay_tx_mismatch = 0u;
+    replay_q_head = replay_q_tail = 0u;
+
+    while (idx < replay_count) {
+
+        uint16_t begin = idx;
+        uint16_t end;
+
+        if (replay_entries[begin].type != MEGADUCK_TRACE_BEGIN) {
+            // Tail of a transaction cut off by the ring buffer
+            while ((idx < replay_count) && (replay_entries[idx].type != MEGADUCK_TRACE_BEGIN)) idx++;
+            p_result->skipped++;
+            continue;
+        }
+
+        // Find its end, a transaction without one was cut off at the end of the trace
+        for (end = begin + 1u; end < replay_count; end++)
+            if ((replay_entries[end].type == MEGADUCK_TRACE_END) || (replay_entries[end].type == MEGADUCK_TRACE_BEGIN))
+                break;
+        if ((end >= replay_count) || (replay_entries[end].type != MEGADUCK_TRACE_END) ||
+            (replay_entries[begin + 1u].type != MEGADUCK_TRACE_TX)) {
+            p_result->skipped++;
+            idx = end;
+            continue;
+        }
+
+        // Start at the recorded time, ticks are summed up per transaction so
+        // only the gaps between transactions need to be under 16 seconds
+        if (!started) {
+            prev_tick = replay_entries[begin].tick;
+            started   = true;
+        }
+        elapsed  += (uint64_t)(uint16_t)(replay_entries[begin].tick - prev_tick) * SIM_MCYCLES_PER_TIMA_4KHZ;
+        prev_tick = replay_entries[begin].tick;
+        if (sim_cycles < start + elapsed)
+            sim_advance((uint32_t)(start + elapsed - sim_cycles));
+
+        uint8_t  io_cmd = replay_entries[begin + 1u].data;
+        uint64_t t0     = sim_cycles;
+        bool     ok;
+
+        replay_cursor  = begin + 1u;
+        replay_running = true;
+
+        if (replay_entries[begin].data == MEGADUCK_TRACE_TXN_SEND) {
+            replay_load_tx_buf(begin + 1u, end);
+            serial_io_begin_command_and_buffer(io_cmd);
+        } else
+            serial_io_begin_command_and_receive_buffer(io_cmd, megaduck_serial_rx_buf, MEGADUCK_RX_MAX_PAYLOAD_LEN);
+
+        while (serial_io_poll_transaction() == SERIAL_IO_STATUS_BUSY);
+        ok = serial_io_get_transaction_result();
+
+        replay_running = false;
+        replay_q_head  = replay_q_tail = 0u;
+
+        p_result->mcycles += sim_cycles - t0;
+        p_result->transactions++;
+        if (ok) p_result->ok++;
+        if (ok != (replay_entries[end].data == SERIAL_IO_STATUS_DONE))
+            p_result->status_mismatch++;
+
+        idx = end + 1u;
+    }
+    p_result->tx_mismatch = replay_tx_mismatch;
+}
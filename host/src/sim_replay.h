@@ -0,0 +1,38 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef _SIM_REPLAY_H
+#define _SIM_REPLAY_H
+
+// Replays a link trace (see megaduck_link_trace.h) against the protocol code
+//
+// - The peripheral side answers with the bytes received in the trace, at
+//   the recorded timing (to the nearest tick), and checks the Duck sends
+//   the same bytes it did back then
+// - The Duck side starts the same transactions at the recorded times
+//   through the transaction engine, with the current serial_io_policy
+// - Transactions cut off at either end of the ring buffer are skipped
+
+#define SIM_REPLAY_ENTRIES_MAX  256u
+
+typedef struct sim_replay_result_t {
+    uint16_t transactions;     // Replayed transactions
+    uint16_t ok;               // ... that succeeded
+    uint16_t status_mismatch;  // ... with an outcome other than in the trace
+    uint16_t tx_mismatch;      // Bytes the Duck sent that differ from the trace (or weren't in it)
+    uint16_t skipped;          // Incomplete transactions at the ends of the trace
+    uint64_t mcycles;          // Time spent in the replayed transactions
+} sim_replay_result_t;
+
+bool     sim_replay_load(const uint8_t * p_image, uint32_t len);
+uint16_t sim_replay_entry_count(void);
+void     sim_replay_dump(void);
+void     sim_replay_run(sim_replay_result_t * p_result);
+
+// Peripheral side, used by sim_peripheral.c while a replay runs
+bool     sim_replay_active(void);
+void     sim_replay_rx_byte(uint8_t rx_byte);
+bool     sim_replay_tx_ready(void);
+uint8_t  sim_replay_tx_take(void);
+
+#endif // _SIM_REPLAY_H
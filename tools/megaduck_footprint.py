@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+#
+# Prints the ROM and WRAM used per symbol by the library modules
+# linked into a ROM, to keep track of the common/ footprint
+#
+# - Which modules were linked comes from the "Libraries Linked" part
+#   of the linker .map file (lcc -Wl-m)
+# - Sizes come from the module object files (SDCC .rel format): each
+#   global symbol gets the bytes from its offset up to the next global
+#   symbol in the same area, so static functions and data count toward
+#   the global before them (or "(static)" if there is none)
+# - WRAM is _DATA, _BSS and _INITIALIZED, every other area with a size
+#   (code, constants, initializers, interrupt vectors) is ROM
+#
+# usage: megaduck_footprint.py --map ROM.map --lib LIBNAME [--title TEXT] [--all] OBJECTS...
+#   ex: megaduck_footprint.py --map build/duck/rom.map --lib megaduck_common.lib obj/duck/common/*.o
+
+import argparse
+import os
+import re
+import sys
+
+WRAM_AREAS = ('_DATA', '_BSS', '_INITIALIZED')
+
+RADIX = { 'X': 16, 'D': 10, 'Q': 8 }
+
+
+def fail(msg):
+    sys.exit('megaduck_footprint: error: ' + msg)
+
+
+# Returns the object file names pulled out of the library, from the .map file
+def linked_objects(map_path, lib_name):
+
+    objects = set()
+    in_libs = False
+
+    try:
+        with open(map_path, 'r', errors='replace') as f:
+            for line in f:
+                if line.startswith('Libraries Linked'):
+                    in_libs = True
+                    continue
+                if not in_libs:
+                    continue
+                m = re.match(r'^\s*(\S+)\s+\[\s*(\S+)\s*\]', line)
+                if m:
+                    if os.path.basename(m.group(1)) == lib_name:
+                        objects.add(os.path.basename(m.group(2)))
+                elif line.strip() and not line.startswith(' ') and not line.startswith('-'):
+                    in_libs = False  # Next section
+    except OSError as e:
+        fail('can\'t read %s (%s)' % (map_path, e.strerror))
+
+    return objects
+
+
+# Returns [(area, symbol, size)] for one .rel object file
+def object_symbols(obj_path):
+
+    areas = []  # [name, size, [(offset, symbol)]]
+
+    try:
+        with open(obj_path, 'r', errors='replace') as f:
+            lines = f.read().splitlines()
+    except OSError as e:
+        fail('can\'t read %s (%s)' % (obj_path, e.strerror))
+
+    if not lines or lines[0][:1] not in RADIX:
+        fail('%s is not an SDCC object file' % obj_path)
+    radix = RADIX[lines[0][0]]
+
+    for line in lines[1:]:
+        fields = line.split()
+        if len(fields) >= 3 and fields[0] == 'A' and fields[2] == 'size':
+            areas.append([fields[1], int(fields[3], radix), []])
+        elif len(fields) == 3 and fields[0] == 'S' and fields[2].startswith('Def') and areas:
+            if not fields[1].startswith('.'):
+                areas[-1][2].append((int(fields[2][3:], radix), fields[1]))
+
+    symbols = []
+    for name, size, defs in areas:
+        if (size == 0) or name.startswith('.'):
+            continue
+        defs = sorted(d for d in defs if d[0] < size)
+        if not defs or defs[0][0] > 0:
+            defs.insert(0, (0, '(static)'))
+        for c, (offset, symbol) in enumerate(defs):
+            end = defs[c + 1][0] if (c + 1 < len(defs)) else size
+            if end > offset:
+                symbols.append((name, symbol, end - offset))
+    return symbols
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Per symbol ROM / WRAM use of the library modules in a ROM')
+    parser.add_argument('--map', required=True, help='linker .map file of the ROM')
+    parser.add_argument('--lib', required=True, help='library file name as linked (ex: megaduck_common.lib)')
+    parser.add_argument('--title', default=None, help='heading for the report')
+    parser.add_argument('--all', action='store_true', help='also list modules that were not linked')
+    parser.add_argument('objects', nargs='+', help='object files the library was built from')
+    args = parser.parse_args()
+
+    linked = linked_objects(args.map, args.lib)
+    if not linked:
+        fail('no modules from %s in %s' % (args.lib, args.map))
+
+    print('%s: %s' % (args.title or os.path.basename(args.map), args.lib))
+    print('%-44s %6s %6s' % ('module / symbol', 'ROM', 'WRAM'))
+
+    total_rom = total_wram = 0
+    unused = []
+
+    for obj_path in sorted(args.objects):
+        module = os.path.basename(obj_path)
+        if module not in linked:
+            unused.append(module)
+            continue
+
+        sizes = {}  # symbol -> [rom, wram]
+        for area, symbol, size in object_symbols(obj_path):
+            entry = sizes.setdefault(symbol, [0, 0])
+            entry[1 if area in WRAM_AREAS else 0] += size
+
+        rom  = sum(s[0] for s in sizes.values())
+        wram = sum(s[1] for s in sizes.values())
+        total_rom  += rom
+        total_wram += wram
+
+        print('%-44s %6d %6d' % (os.path.splitext(module)[0], rom, wram))
+        for symbol, (sym_rom, sym_wram) in sorted(sizes.items(), key=lambda s: (-s[1][0], -s[1][1], s[0])):
+            print('  %-42s %6d %6d' % (symbol, sym_rom, sym_wram))
+
+    print('%-44s %6d %6d' % ('total (%d of %d modules)' % (len(args.objects) - len(unused), len(args.objects)),
+                             total_rom, total_wram))
+    if args.all and unused:
+        print('not linked: ' + ' '.join(os.path.splitext(m)[0] for m in unused))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,349 @@
+#!/usr/bin/env python3
+#
+# Generates the keycode -> character tables for the Mega Duck laptop
+# keyboard from layout description files (see example_keyboard/layouts/)
+#
+# Each layout gets one character array holding the plain then the shift
+# characters, split into the 4 scan code rows (key_code & 0x03)
+#
+# - Rows are indexed by column ((key_code - MEGADUCK_KEY_BASE) >> 2) and
+#   trimmed to their first..last column that has a character, anything
+#   outside that window translates to NO_KEY
+# - There are no Caps Lock tables: Caps Lock gives the shift character of
+#   letters, so a letter's shift character has to be its upper case.
+#   Letters outside a-z are listed in megaduck_keymap_caps_letters[]
+# - Caps lock + Shift gives the unshifted characters (same as the hardware
+#   behavior the old runtime translation copied)
+# - A layout whose base is also generated only stores the keys that differ
+#   from it (when that's smaller), and shares the base's rows
+# - Characters are single byte code page 437 values (the GBDK IBM PC font)
+# - The tables can be placed in a switchable ROM bank (MEGADUCK_BANKED),
+#   so they're only read through the accessors in megaduck_key2ascii.c
+#
+# usage: megaduck_keymap_gen.py --keycodes megaduck_keycodes.h --models megaduck_model.h
+#                               -o megaduck_keymaps.c layout [layout ...]
+
+import argparse
+import os
+import re
+import sys
+
+ENCODING = 'cp437'
+
+MOD_NAMES = ('plain', 'shift')
+
+ROW_COUNT    = 4   # Scan code rows, key_code & 0x03
+COLUMN_COUNT = 28  # 0x80 - 0xEF
+
+# Quoted characters, comments, everything else split on whitespace
+TOKEN_RE = re.compile(r"'(?:[^'\\]|\\.)'|#.*|\S+")
+
+
+def fail(msg):
+    sys.exit('megaduck_keymap_gen: error: ' + msg)
+
+
+def parse_defines(path, prefix):
+    defines = {}
+    with open(path, encoding='utf-8') as f:
+        for line in f:
+            m = re.match(r'\s*#define\s+' + prefix + r'(\w+)\s+(0x[0-9A-Fa-f]+|\d+)u?\b', line)
+            if m:
+                defines[m.group(1)] = int(m.group(2), 0)
+    if not defines:
+        fail('no %s* defines found in %s' % (prefix, path))
+    return defines
+
+
+def parse_value(token, where):
+    # Returns a byte value or a symbolic name (NO_KEY, KEY_*)
+    if token == 'NO_KEY' or token.startswith('KEY_'):
+        return token
+    if token.startswith("'") and token.endswith("'") and len(token) >= 3:
+        token = token[1:-1]
+        if token.startswith('\\'):
+            token = token[1:]
+    elif re.fullmatch(r'0x[0-9A-Fa-f]{2}', token):
+        return int(token, 16)
+    if len(token) != 1:
+        fail('%s: "%s" is not a single character' % (where, token))
+    try:
+        return token.encode(ENCODING)[0]
+    except UnicodeEncodeError:
+        fail('%s: "%s" has no code page 437 equivalent, use a 0xNN value' % (where, token))
+
+
+def caps_of(value):
+    # Caps lock only changes letters that have a single character upper case
+    if isinstance(value, str):
+        return value
+    ch = bytes([value]).decode(ENCODING)
+    upper = ch.upper()
+    if ch.isalpha() and (len(upper) == 1) and (upper != ch):
+        try:
+            return upper.encode(ENCODING)[0]
+        except UnicodeEncodeError:
+            pass
+    return value
+
+
+class Layout:
+    def __init__(self):
+        self.name = None
+        self.model = None
+        self.default = False
+        self.base = None
+        self.plain = {}
+        self.shift = {}
+
+
+def load_layout(path, keycodes, loading=()):
+    if path in loading:
+        fail('%s: circular base layout' % path)
+
+    layout = Layout()
+    with open(path, encoding='utf-8') as f:
+        lines = f.readlines()
+
+    for num, line in enumerate(lines, 1):
+        where = '%s:%d' % (path, num)
+        tokens = [t for t in TOKEN_RE.findall(line) if not t.startswith('#')]
+        if not tokens:
+            continue
+        key = tokens[0]
+
+        if key == 'name' and len(tokens) == 2:
+            layout.name = tokens[1]
+        elif key == 'model' and len(tokens) == 2:
+            layout.model = tokens[1]
+        elif key == 'default' and len(tokens) == 1:
+            layout.default = True
+        elif key == 'base' and len(tokens) == 2:
+            base = load_layout(os.path.join(os.path.dirname(path), tokens[1] + '.layout'),
+                               keycodes, loading + (path,))
+            layout.base = base.name
+            layout.plain.update(base.plain)
+            layout.shift.update(base.shift)
+        elif key in keycodes and len(tokens) in (2, 3):
+            code = keycodes[key]
+            layout.plain[code] = parse_value(tokens[1], where)
+            layout.shift[code] = parse_value(tokens[2], where) if len(tokens) == 3 else 'NO_KEY'
+        else:
+            fail('%s: unrecognized line "%s"' % (where, line.strip()))
+
+    if layout.name is None or not re.fullmatch(r'[a-z_][a-z0-9_]*', layout.name):
+        fail('%s: missing or invalid "name"' % path)
+    return layout
+
+
+def build_rows(entries, key_base):
+    # Returns [(first column, [values])] for each row
+    rows = []
+    for row in range(ROW_COUNT):
+        columns = dict(((code - key_base) >> 2, value) for code, value in entries.items()
+                       if ((code - key_base) & 0x03) == row and value != 'NO_KEY')
+        if not columns:
+            rows.append((0, []))
+            continue
+        first, last = min(columns), max(columns)
+        rows.append((first, [columns.get(column, 'NO_KEY') for column in range(first, last + 1)]))
+    return rows
+
+
+def check_caps(layout, code_names):
+    # Caps lock uses the shift character of letters, see megaduck_key2ascii.c
+    for code, value in layout.plain.items():
+        upper = caps_of(value)
+        if (upper != value) and (layout.shift.get(code, 'NO_KEY') != upper):
+            fail('layout %s: %s: the shift character of "%s" must be its upper case "%s" for Caps Lock'
+                 % (layout.name, code_names[code], bytes([value]).decode(ENCODING),
+                    bytes([upper]).decode(ENCODING)))
+
+
+def format_value(value):
+    if isinstance(value, str):
+        return value
+    if (0x20 <= value < 0x7F):
+        ch = chr(value)
+        if ch in ("'", '\\'):
+            ch = '\\' + ch
+        return "'%s'" % ch
+    return '0x%02Xu' % value
+
+
+def format_comment(value):
+    if isinstance(value, int) and (value >= 0x80):
+        return ' %s' % bytes([value]).decode(ENCODING)
+    return ''
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate Mega Duck keyboard keymap tables')
+    parser.add_argument('--keycodes', required=True, help='megaduck_keycodes.h')
+    parser.add_argument('--models', required=True, help='megaduck_model.h')
+    parser.add_argument('-o', '--output', required=True)
+    parser.add_argument('layouts', nargs='+')
+    args = parser.parse_args()
+
+    keycodes = parse_defines(args.keycodes, 'MEGADUCK_KEY_')
+    models = dict(('MEGADUCK_' + name, value) for name, value in parse_defines(args.models, 'MEGADUCK_').items()
+                  if name.startswith(('HANDHELD_', 'LAPTOP_')))
+    model_names = dict((value, name) for name, value in models.items())
+
+    key_base = keycodes['BASE']
+    code_names = dict((value, name) for name, value in keycodes.items()
+                      if (value >= key_base) and (name != 'BASE'))
+    layouts = [load_layout(path, keycodes) for path in args.layouts]
+    defaults = [l for l in layouts if l.default]
+    if len(defaults) != 1:
+        fail('exactly one layout must be marked "default"')
+    by_name = dict((layout.name, layout) for layout in layouts)
+    for layout in layouts:
+        for code in layout.plain:
+            if (code < key_base) or ((code - key_base) >> 2 >= COLUMN_COUNT):
+                fail('layout %s: %s: 0x%02X is not a key scan code' % (layout.name, code_names.get(code, '?'), code))
+        check_caps(layout, code_names)
+
+    # Rows are emitted for layouts without a generated base, or where the
+    # differing keys take more space than own rows would
+    out = []
+    layout_rows = {}   # name -> (array name, [(offset, first, count)] plain rows then shift rows, size)
+    layout_keys = {}   # name -> [(code, plain, shift)]
+
+    def rows_of(layout):
+        values = []
+        refs = []
+        for mod, entries in zip(MOD_NAMES, (layout.plain, layout.shift)):
+            for row, (first, row_values) in enumerate(build_rows(entries, key_base)):
+                refs.append((len(values) if row_values else 0, first, len(row_values), mod, row))
+                values += row_values
+        return values, refs
+
+    def root_of(layout):
+        while (layout.base in by_name) and (layout.name not in layout_rows):
+            layout = by_name[layout.base]
+        return layout
+
+    def emit_rows(layout):
+        values, refs = rows_of(layout)
+        if len(values) > 0xFF:
+            fail('layout %s: %d characters, more than an 8 bit offset reaches' % (layout.name, len(values)))
+        name = 'keymap_%s_chars' % layout.name
+        out.append('// %s: %d bytes' % (name, len(values)))
+        out.append('static const char %s[] = {' % name)
+        for offset, first, count, mod, row in refs:
+            if count:
+                out.append('    // %s, row %d: columns %d - %d' % (mod, row, first, first + count - 1))
+                for column in range(first, first + count):
+                    value = values[offset + column - first]
+                    code = key_base + (column << 2) + row
+                    out.append('    %-16s // 0x%02X%s' % (format_value(value) + ',', code, format_comment(value)))
+        out.append('};')
+        out.append('')
+        layout_rows[layout.name] = (name, [ref[:3] for ref in refs], len(values))
+
+    # Layouts with their own rows first, so based ones can find theirs
+    for layout in layouts:
+        if layout.base not in by_name:
+            emit_rows(layout)
+    pending = [l for l in layouts if l.name not in layout_rows]
+    while pending:
+        for layout in pending:
+            root = root_of(layout)
+            if root.name not in layout_rows:
+                continue
+            codes = sorted(set(layout.plain) | set(layout.shift) | set(root.plain) | set(root.shift))
+            keys = [(code, layout.plain.get(code, 'NO_KEY'), layout.shift.get(code, 'NO_KEY')) for code in codes
+                    if (layout.plain.get(code, 'NO_KEY'), layout.shift.get(code, 'NO_KEY'))
+                    != (root.plain.get(code, 'NO_KEY'), root.shift.get(code, 'NO_KEY'))]
+            if (len(keys) * 3) < len(rows_of(layout)[0]):
+                layout_rows[layout.name] = layout_rows[root.name]
+                layout_keys[layout.name] = keys
+                name = 'keymap_%s_keys' % layout.name
+                out.append('// %s: %d keys that differ from %s (%d bytes)' % (name, len(keys), root.name, len(keys) * 3))
+                out.append('static const megaduck_keymap_key_t %s[] = {' % name)
+                for code, plain, shift in keys:
+                    out.append('    { 0x%02Xu, %-8s %-7s },  // %s%s%s' % (code, format_value(plain) + ',', format_value(shift),
+                               code_names[code], format_comment(plain), format_comment(shift)))
+                out.append('};')
+                out.append('')
+            else:
+                emit_rows(layout)
+        pending = [l for l in pending if l.name not in layout_rows]
+
+    for layout in layouts:
+        name, refs, _ = layout_rows[layout.name]
+        keys = layout_keys.get(layout.name, [])
+        out.append('const megaduck_keymap_t keymap_%s = {' % layout.name)
+        out.append('    %s,' % name)
+        out.append('    {')
+        for mod_index, mod in enumerate(MOD_NAMES):
+            out.append('        {  // %s' % mod)
+            for offset, first, count in refs[mod_index * ROW_COUNT:(mod_index + 1) * ROW_COUNT]:
+                out.append('            { %3du, %2du, %2du },' % (offset, first, count))
+            out.append('        },')
+        out.append('    },')
+        if keys:
+            out.append('    keymap_%s_keys, %du,' % (layout.name, len(keys)))
+        else:
+            out.append('    NULL, 0u,')
+        out.append('};')
+        out.append('')
+
+    # Letters Caps Lock changes, other than a-z
+    letters = sorted(set(value for layout in layouts for value in layout.plain.values()
+                         if (caps_of(value) != value) and not (ord('a') <= value <= ord('z'))))
+    out.append('// Letters Caps Lock gives the shift character for, besides a-z')
+    out.append('const char megaduck_keymap_caps_letters[] = {')
+    for value in letters:
+        out.append('    %-16s //%s' % (format_value(value) + ',', format_comment(value)))
+    out.append('    NO_KEY')
+    out.append('};')
+    out.append('')
+
+    by_model = {}
+    for layout in layouts:
+        if layout.model is not None:
+            if layout.model not in models:
+                fail('layout %s: unknown model %s' % (layout.name, layout.model))
+            by_model[models[layout.model]] = layout.name
+
+    out.append('// Unknown or handheld models use the default layout')
+    out.append('const megaduck_keymap_t * const megaduck_keymaps_by_model[MEGADUCK_MODEL_COUNT] = {')
+    for index in range(len(model_names)):
+        out.append('    &keymap_%s,  // %s' % (by_model.get(index, defaults[0].name), model_names[index]))
+    out.append('};')
+    out.append('')
+    out.append('const megaduck_keymap_t * p_megaduck_keymap = &keymap_%s;' % defaults[0].name)
+
+    header = [
+        '// Generated by megaduck_keymap_gen.py from: %s' % ' '.join(os.path.basename(p) for p in args.layouts),
+        '// Do not edit, change the layout files instead',
+        '',
+        '// Built with MEGADUCK_BANKED the tables go to a switchable ROM bank',
+        '// picked by the bank packer, see megaduck_key2ascii.c for access',
+        '#ifdef MEGADUCK_BANKED',
+        '#pragma bank 255',
+        '#endif',
+        '',
+        '#include <gbdk/platform.h>',
+        '#include <stdint.h>',
+        '',
+        '#include <megaduck_model.h>',
+        '',
+        '#include "megaduck_key2ascii.h"',
+        '#include "megaduck_keyboard.h"',
+        '',
+        '#ifdef MEGADUCK_BANKED',
+        'BANKREF(megaduck_keymaps)',
+        '#endif',
+        '',
+        '',
+    ]
+
+    with open(args.output, 'w', encoding='utf-8') as f:
+        f.write('\n'.join(header + out) + '\n')
+
+
+if __name__ == '__main__':
+    main()
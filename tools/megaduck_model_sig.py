@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+#
+# Prints a model signature table entry for common/src/megaduck_model.c
+# from the 32 bytes of font tiles found in VRAM at 0x8D00 on a laptop
+# model launched from its System ROM (ex: from an emulator VRAM dump)
+#
+# - hash is the same Fletcher style hash as megaduck_model_hash()
+# - The check byte is picked so it differs from the tiles of the models
+#   already in the table (given with --other), to rule out collisions
+#
+# usage: megaduck_model_sig.py [--other 32 hex bytes ...] MODEL_NAME 32 hex bytes
+#   ex: megaduck_model_sig.py MEGADUCK_LAPTOP_GERMAN 00 00 00 ... FF
+
+import argparse
+import sys
+
+SIG_LEN = 32
+
+
+def fail(msg):
+    sys.exit('megaduck_model_sig: error: ' + msg)
+
+
+def parse_bytes(tokens):
+    values = []
+    for token in tokens:
+        for part in token.replace(',', ' ').split():
+            try:
+                values.append(int(part, 16) & 0xFF)
+            except ValueError:
+                fail('"%s" is not a hex byte' % part)
+    if len(values) != SIG_LEN:
+        fail('expected %d bytes, got %d' % (SIG_LEN, len(values)))
+    return values
+
+
+def model_hash(values):
+    sum_lo = sum_hi = 0
+    for value in values:
+        sum_lo = (sum_lo + value) & 0xFF
+        sum_hi = (sum_hi + sum_lo) & 0xFF
+    return (sum_hi << 8) | sum_lo
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Make a Mega Duck model VRAM signature')
+    parser.add_argument('--other', action='append', default=[],
+                        help='tile bytes of a model already in the table (quoted, repeatable)')
+    parser.add_argument('model')
+    parser.add_argument('tiles', nargs='+')
+    args = parser.parse_args()
+
+    values = parse_bytes(args.tiles)
+    others = [parse_bytes([other]) for other in args.other]
+
+    # Blank (0x00) and unwritten (0xFF) VRAM should never match either
+    others += [[0x00] * SIG_LEN, [0xFF] * SIG_LEN]
+
+    for idx, value in enumerate(values):
+        if all(other[idx] != value for other in others):
+            break
+    else:
+        fail('no byte differs from all the other models')
+
+    print('    { 0x%04Xu, %2du, 0x%02Xu, %s },' % (model_hash(values), idx, value, args.model))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,322 @@
+#!/usr/bin/env python3
+#
+# Runs the SM83 serial byte primitives (common/src/megaduck_serial_io_sm83.s)
+# on a small SM83 interpreter, since the host build only has the C versions
+#
+# - Only the instructions those routines use are supported, anything
+#   else is an error so new code doesn't go unchecked by accident
+# - Hardware is cut down to what they touch: TIMA counting at 4096 Hz,
+#   SB / SC with a transfer that finishes after a set time, IF / IE,
+#   FF60 and the C globals they read and write
+# - M-cycle counts per instruction are from the SM83 timing tables
+#
+# usage: megaduck_sm83_check.py megaduck_serial_io_sm83.s
+
+import re
+import sys
+
+MCYCLES_PER_TICK = 256          # TIMA at 4096 Hz
+LINK_BYTE_MCYCLES = 2 * 256     # Internal clock transfer time used by the checks
+
+# From GBDK's global.s
+IO_REGS = { '.SB': 0x01, '.SC': 0x02, '.TIMA': 0x05, '.IF': 0x0F, '.IE': 0xFF }
+
+# C globals the routines use, at made up WRAM addresses
+GLOBALS = { '_serial_byte_recieved': 0xC000, '_serial_io_tx_ticks_measured': 0xC001 }
+
+R8 = ('a', 'b', 'c', 'd', 'e', 'h', 'l')
+R16 = { 'bc': ('b', 'c'), 'de': ('d', 'e'), 'hl': ('h', 'l') }
+
+
+def fail(msg):
+    sys.exit('megaduck_sm83_check: error: ' + msg)
+
+
+class Program:
+
+    def __init__(self, path):
+        self.symbols = dict(IO_REGS)
+        self.symbols.update(GLOBALS)
+        self.code = []    # (line number, mnemonic, [operands], scope)
+        self.values = {}  # Evaluated expressions
+        self.labels = {}  # name -> index into code, local labels as "scope:N$"
+
+        scope = ''
+        try:
+            with open(path, 'r') as f:
+                lines = f.read().splitlines()
+        except OSError as e:
+            fail('can\'t read %s (%s)' % (path, e.strerror))
+
+        for num, line in enumerate(lines, 1):
+            line = line.split(';', 1)[0].strip()
+            if not line or line.startswith('.'):
+                continue
+            m = re.match(r'^([A-Za-z_]\w*)\s*=\s*(.+)$', line)
+            if m:
+                self.symbols[m.group(1)] = self.eval(m.group(2), num)
+                continue
+            m = re.match(r'^(\d+\$|[A-Za-z_]\w*)::?\s*(.*)$', line)
+            if m:
+                if m.group(1).endswith('$'):
+                    self.labels[scope + ':' + m.group(1)] = len(self.code)
+                else:
+                    scope = m.group(1)
+                    self.labels[scope] = len(self.code)
+                line = m.group(2)
+                if not line:
+                    continue
+            parts = line.split(None, 1)
+            operands = [o.strip() for o in parts[1].split(',')] if len(parts) > 1 else []
+            self.code.append((num, parts[0].lower(), operands, scope))
+
+    def eval(self, expr, num):
+        if expr in self.values:
+            return self.values[expr]
+        def symbol(m):
+            if m.group(0) not in self.symbols:
+                fail('line %d: unknown symbol %s' % (num, m.group(0)))
+            return str(self.symbols[m.group(0)])
+        try:
+            self.values[expr] = eval(re.sub(r'(?<!\w)\.?[A-Za-z_]\w*', symbol, expr), {}) & 0xFFFF
+            return self.values[expr]
+        except SyntaxError:
+            fail('line %d: can\'t evaluate %s' % (num, expr))
+
+
+class Cpu:
+
+    def __init__(self, program):
+        self.prog = program
+        self.reg = dict.fromkeys(R8, 0)
+        self.flag_z = self.flag_c = False
+        self.mem = {}
+        self.mcycles = 0
+        self.ime = True
+        self.tima_start = 0
+        self.xfer_done_at = None  # M-cycle a started internal clock transfer finishes, None if it never does
+        self.byte_at = None       # M-cycle the serial ISR would set serial_byte_recieved
+
+    # == Hardware ==
+
+    def tick(self):
+        return (self.mcycles - self.tima_start) // MCYCLES_PER_TICK
+
+    def read(self, addr):
+        if addr == 0xFF00 + IO_REGS['.TIMA']:
+            return self.tick() & 0xFF
+        if addr == 0xFF00 + IO_REGS['.SC']:
+            sc = self.mem.get(addr, 0)
+            if (sc & 0x81) == 0x81 and self.xfer_done_at is not None and self.mcycles >= self.xfer_done_at:
+                sc &= 0x7F
+                self.mem[addr] = sc
+                self.mem[0xFF0F] = self.mem.get(0xFF0F, 0) | 0x08
+            return sc
+        if addr == GLOBALS['_serial_byte_recieved'] and self.byte_at is not None and self.mcycles >= self.byte_at:
+            return 1
+        return self.mem.get(addr, 0)
+
+    def write(self, addr, value):
+        self.mem[addr] = value & 0xFF
+
+    # == Operands ==
+
+    def get16(self, name):
+        hi, lo = R16[name]
+        return (self.reg[hi] << 8) | self.reg[lo]
+
+    def set16(self, name, value):
+        hi, lo = R16[name]
+        self.reg[hi] = (value >> 8) & 0xFF
+        self.reg[lo] = value & 0xFF
+
+    def value(self, op, num):
+        if op in R8:
+            return self.reg[op]
+        if op == '(hl)':
+            return self.read(self.get16('hl'))
+        if op.startswith('#'):
+            return self.prog.eval(op[1:], num) & 0xFF
+        if op.startswith('('):
+            return self.read(self.prog.eval(op[1:-1], num))
+        fail('line %d: unsupported operand %s' % (num, op))
+
+    def store(self, op, value, num):
+        if op in R8:
+            self.reg[op] = value & 0xFF
+        elif op == '(hl)':
+            self.write(self.get16('hl'), value)
+        elif op.startswith('('):
+            self.write(self.prog.eval(op[1:-1], num), value)
+        else:
+            fail('line %d: unsupported operand %s' % (num, op))
+
+    def cond(self, cc):
+        return { 'nz': not self.flag_z, 'z': self.flag_z, 'nc': not self.flag_c, 'c': self.flag_c }[cc]
+
+    def jump(self, label, scope, num):
+        key = (scope + ':' + label) if label.endswith('$') else label
+        if key not in self.prog.labels:
+            fail('line %d: unknown label %s' % (num, label))
+        return self.prog.labels[key]
+
+    # == Execution ==
+
+    # Runs a routine up to its ret, returns A (None if it ran past max_ticks)
+    def call(self, name, a, max_ticks):
+        if name not in self.prog.labels:
+            fail('no routine %s' % name)
+        self.reg['a'] = a
+        pc = self.prog.labels[name]
+
+        while True:
+            if self.tick() > max_ticks:
+                return None
+            num, mn, ops, scope = self.prog.code[pc]
+            pc += 1
+            a = self.reg['a']
+
+            if mn == 'ld':
+                dst, src = ops
+                if dst in R16:
+                    self.set16(dst, self.prog.eval(src[1:], num))
+                    self.mcycles += 3
+                else:
+                    self.store(dst, self.value(src, num), num)
+                    mem_op = [o for o in ops if o.startswith('(')]
+                    imm_op = src.startswith('#')
+                    self.mcycles += 1 + (1 if imm_op else 0) + \
+                                    ((1 if mem_op[0] == '(hl)' else 3) if mem_op else 0)
+            elif mn == 'ldh':
+                dst, src = ops
+                if dst == 'a':
+                    self.reg['a'] = self.read(0xFF00 + self.prog.eval(src[1:-1], num))
+                else:
+                    self.write(0xFF00 + self.prog.eval(dst[1:-1], num), a)
+                self.mcycles += 3
+            elif (mn == 'add') and (ops[0] == 'hl'):
+                result = self.get16('hl') + self.get16(ops[1])
+                self.flag_c = result > 0xFFFF
+                self.set16('hl', result)
+                self.mcycles += 2
+            elif mn in ('add', 'adc', 'sub', 'sbc', 'cp', 'and', 'or', 'xor'):
+                src = ops[-1]
+                v = self.value(src, num)
+                carry = 1 if (self.flag_c and mn in ('adc', 'sbc')) else 0
+                if mn in ('add', 'adc'):
+                    result = a + v + carry
+                    self.flag_c = result > 0xFF
+                elif mn in ('sub', 'sbc', 'cp'):
+                    result = a - v - carry
+                    self.flag_c = result < 0
+                else:
+                    result = { 'and': a & v, 'or': a | v, 'xor': a ^ v }[mn]
+                    self.flag_c = False
+                result &= 0xFF
+                self.flag_z = (result == 0)
+                if mn != 'cp':
+                    self.reg['a'] = result
+                self.mcycles += 2 if (src.startswith('#') or src == '(hl)') else 1
+            elif mn == 'srl':
+                v = self.value(ops[0], num)
+                self.flag_c = bool(v & 0x01)
+                self.store(ops[0], v >> 1, num)
+                self.flag_z = (v >> 1) == 0
+                self.mcycles += 4 if ops[0] == '(hl)' else 2
+            elif mn in ('res', 'set'):
+                bit = 1 << self.prog.eval(ops[0], num)
+                v = self.value(ops[1], num)
+                self.store(ops[1], (v & ~bit) if mn == 'res' else (v | bit), num)
+                self.mcycles += 4 if ops[1] == '(hl)' else 2
+            elif mn == 'jr':
+                taken = self.cond(ops[0]) if len(ops) == 2 else True
+                if taken:
+                    pc = self.jump(ops[-1], scope, num)
+                self.mcycles += 3 if taken else 2
+            elif mn == 'ret':
+                if not ops or self.cond(ops[0]):
+                    self.mcycles += 5 if ops else 4
+                    return self.reg['a']
+                self.mcycles += 2
+            elif mn in ('di', 'ei'):
+                self.ime = (mn == 'ei')
+                self.mcycles += 1
+            else:
+                fail('line %d: unsupported instruction %s' % (num, mn))
+
+
+# == Checks ==
+
+errors = 0
+
+
+def expect(ok, what):
+    global errors
+    if not ok:
+        print('FAIL  ' + what)
+        errors += 1
+
+
+def ticks_from_msec(ms):
+    return (ms << 2) + (ms >> 3)  # MEGADUCK_TICKS_FROM_MSEC()
+
+
+def check_read_timeout(prog):
+    for ms in (1, 2, 20, 100, 255):
+        cpu = Cpu(prog)
+        cpu.write(0xFF0F, 0x1F)
+        got = cpu.call('_serial_io_read_byte_with_msecs_timeout', ms, ticks_from_msec(ms) + 16)
+        ticks = cpu.tick()
+        expect(got is not None, 'read timeout %d ms: still waiting after %d ticks' % (ms, ticks))
+        expect(not got, 'read timeout %d ms: returned a byte' % ms)
+        expect(ticks_from_msec(ms) <= ticks <= ticks_from_msec(ms) + 1,
+               'read timeout %d ms: took %d ticks, expected %d' % (ms, ticks, ticks_from_msec(ms)))
+        expect(cpu.mem.get(0xFF0F) == 0x17, 'read timeout %d ms: IF is %02X, expected 17' % (ms, cpu.mem.get(0xFF0F, 0)))
+        expect(cpu.mem.get(0xFFFF, 0) & 0x08, 'read timeout %d ms: Serial interrupt not enabled' % ms)
+        expect(cpu.mem.get(0xFF02) == 0x80, 'read timeout %d ms: SC not set for external clock' % ms)
+        expect(cpu.ime, 'read timeout %d ms: interrupts left disabled' % ms)
+
+
+def check_read_byte(prog):
+    cpu = Cpu(prog)
+    cpu.byte_at = 5 * MCYCLES_PER_TICK
+    got = cpu.call('_serial_io_read_byte_with_msecs_timeout', 20, 100)
+    expect(got, 'read byte: not received')
+    expect(cpu.tick() == 5, 'read byte: returned at tick %d, expected 5' % cpu.tick())
+
+
+def check_send_byte(prog):
+    cpu = Cpu(prog)
+    cpu.write(0xFF0F, 0x17)
+    cpu.write(0xFF60, 0xFF)
+    cpu.xfer_done_at = LINK_BYTE_MCYCLES
+    expect(cpu.call('_serial_io_send_byte', 0xA5, 16) is not None, 'send byte: did not return')
+    expect(cpu.mem.get(0xFF01) == 0xA5, 'send byte: SB not written')
+    expect(cpu.mem.get(0xFF60) == 0x00, 'send byte: FF60 not written')
+    expect(cpu.mem.get(0xFF0F) == 0x17, 'send byte: IF is %02X, expected 17' % cpu.mem.get(0xFF0F, 0))
+    expect(cpu.mem.get(0xFF02) == 0x80, 'send byte: SC not set back to external clock')
+    expect(cpu.mem.get(GLOBALS['_serial_io_tx_ticks_measured']) == 2, 'send byte: measured ticks not 2')
+
+    # Never finishes: gives up after the TX timeout
+    cpu = Cpu(prog)
+    expect(cpu.call('_serial_io_send_byte', 0x5A, 16) is not None, 'send byte timeout: did not return')
+    expect(cpu.tick() == 8, 'send byte timeout: took %d ticks, expected 8' % cpu.tick())
+    expect(cpu.mem.get(GLOBALS['_serial_io_tx_ticks_measured']) == 8, 'send byte timeout: measured ticks not 8')
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit('usage: megaduck_sm83_check.py megaduck_serial_io_sm83.s')
+
+    prog = Program(sys.argv[1])
+    check_read_timeout(prog)
+    check_read_byte(prog)
+    check_send_byte(prog)
+
+    if errors:
+        sys.exit('megaduck_sm83_check: %d check(s) failed' % errors)
+    print('PASS  sm83 serial primitives')
+
+
+if __name__ == '__main__':
+    main()